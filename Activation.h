@@ -0,0 +1,120 @@
+#ifndef __ACTIVATION_H_
+#define __ACTIVATION_H_
+
+#include <cmath>
+#include <string>
+
+// The networks' tanh, in three tiers of accuracy. Each is a functor the
+// network kernels are templated on, so a tier costs nothing to pick once a
+// loop is running, and the last two are branch free so loops of them
+// compile to vector code.
+//
+//   exact     libm tanh
+//   rational  a ratio of polynomials, within a few ulp of tanhf
+//   table     linear interpolation in a table, within 1e-5 of tanh
+//
+enum Activation {
+  ACTIVATION_EXACT,
+  ACTIVATION_RATIONAL,
+  ACTIVATION_TABLE,
+  ACTIVATIONS
+};
+
+static const char *const ACTIVATION_NAMES[ACTIVATIONS] = { "exact", "rational", "table" };
+
+// the activation with this name, or -1 if there is none
+inline int activation_named(const std::string &name) {
+  for (int a = 0; a < ACTIVATIONS; a++) {
+    if (name == ACTIVATION_NAMES[a]) {
+      return a;
+    }
+  }
+  return -1;
+}
+
+inline float tanh_rational(float x) {
+  const float limit = 7.90531110763549805f;
+  x = x > limit ? limit : x < -limit ? -limit : x;
+  float x2 = x * x;
+  float p = -2.76076847742355e-16f;
+  p = p * x2 + 2.00018790482477e-13f;
+  p = p * x2 - 8.60467152213735e-11f;
+  p = p * x2 + 5.12229709037114e-08f;
+  p = p * x2 + 1.48572235717979e-05f;
+  p = p * x2 + 6.37261928875436e-04f;
+  p = p * x2 + 4.89352455891786e-03f;
+  float q = 1.19825839466702e-06f;
+  q = q * x2 + 1.18534705686654e-04f;
+  q = q * x2 + 2.26843463243900e-03f;
+  q = q * x2 + 4.89352518554385e-03f;
+  return x * p / q;
+}
+
+// tanh sampled every 1/STEPS over [-LIMIT, LIMIT]; past that it is within
+// 2e-7 of +-1, which the last entries are
+struct TanhSamples {
+  enum { LIMIT = 8, STEPS = 256, SIZE = 2 * LIMIT * STEPS + 2 };
+
+  float y[SIZE];
+
+  TanhSamples() {
+    for (int i = 0; i < SIZE; i++) {
+      y[i] = (float)tanh((double)i / STEPS - LIMIT);
+    }
+  }
+
+  static const TanhSamples &get() {
+    static const TanhSamples samples;
+    return samples;
+  }
+};
+
+inline float tanh_table(const float *y, float x) {
+  const float hi = (float)TanhSamples::LIMIT * 2.0f;
+  float t = (x + (float)TanhSamples::LIMIT) * (float)TanhSamples::STEPS;
+  t = t < 0.0f ? 0.0f : t > hi * TanhSamples::STEPS ? hi * TanhSamples::STEPS : t;
+  int i = (int)t;
+  float f = t - (float)i;
+  return y[i] + (y[i + 1] - y[i]) * f;
+}
+
+struct TanhExact {
+  float operator()(float x) const {
+    return tanh(x);
+  }
+};
+
+struct TanhRational {
+  float operator()(float x) const {
+    return tanh_rational(x);
+  }
+};
+
+struct TanhTable {
+  const float *y;
+
+  TanhTable() : y(TanhSamples::get().y) {
+  }
+
+  float operator()(float x) const {
+    return tanh_table(y, x);
+  }
+};
+
+// genome.forward(...) under the activation picked at runtime
+template <typename G, typename... Args>
+inline void forward_as(int activation, const G &genome, Args &... args) {
+  switch (activation) {
+  case ACTIVATION_RATIONAL:
+    genome.template forward<TanhRational>(args...);
+    break;
+  case ACTIVATION_TABLE:
+    genome.template forward<TanhTable>(args...);
+    break;
+  default:
+    genome.template forward<TanhExact>(args...);
+    break;
+  }
+}
+
+#endif
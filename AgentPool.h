@@ -0,0 +1,95 @@
+#ifndef __AGENT_POOL_H_
+#define __AGENT_POOL_H_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// A reference to one agent that outlives it safely: the slot's index in the
+// low INDEX_BITS, and in the rest the generation the slot was in when the
+// handle was taken. 0 is no agent.
+typedef uint32_t AgentHandle;
+
+// Agents in chunks of CHUNK slots. Growing adds chunks and never moves the
+// slots already there, so references into the pool stay good. Every slot
+// has a generation, bumped by retire() when its agent leaves, so a handle to
+// an agent that has gone no longer resolves, even once the slot is taken
+// again. A slot's generation is never 0, which keeps handle 0 free for no
+// agent.
+//
+// T keeps its own index in a member named slot, set as slots are made.
+template <typename T>
+class AgentPool {
+public:
+  enum {
+    INDEX_BITS = 22,
+    MAX_SLOTS = 1 << INDEX_BITS,
+    GENERATIONS = 1 << (32 - INDEX_BITS),
+    CHUNK_BITS = 12,
+    CHUNK = 1 << CHUNK_BITS
+  };
+
+  AgentPool() : slots(0) {
+  }
+
+  // slots made so far; all of them stay where they are
+  int capacity() const {
+    return slots;
+  }
+
+  // makes at least count slots, a chunk at a time
+  void reserve(int count) {
+    assert(count <= MAX_SLOTS);
+    while (slots < count) {
+      chunks.push_back(std::unique_ptr<T[]>(new T[CHUNK]));
+      for (int i = 0; i < CHUNK; i++) {
+        chunks.back()[i].slot = slots + i;
+      }
+      generations.resize(slots + CHUNK, 1);
+      slots += CHUNK;
+    }
+  }
+
+  T &operator[](int index) {
+    return chunks[index >> CHUNK_BITS][index & (CHUNK - 1)];
+  }
+
+  const T &operator[](int index) const {
+    return chunks[index >> CHUNK_BITS][index & (CHUNK - 1)];
+  }
+
+  AgentHandle handle(int index) const {
+    return (AgentHandle)generations[index] << INDEX_BITS | (AgentHandle)index;
+  }
+
+  static int index_of(AgentHandle handle) {
+    return (int)(handle & (MAX_SLOTS - 1));
+  }
+
+  // the agent a handle was taken to, or 0 if it has left since
+  T *get(AgentHandle handle) {
+    int index = index_of(handle);
+    if (index >= slots || handle >> INDEX_BITS != generations[index]) {
+      return 0;
+    }
+    return &(*this)[index];
+  }
+
+  const T *get(AgentHandle handle) const {
+    return const_cast<AgentPool *>(this)->get(handle);
+  }
+
+  // the slot's agent has left; handles to it resolve to nothing from now on
+  void retire(int index) {
+    uint16_t next = (uint16_t)((generations[index] + 1) % GENERATIONS);
+    generations[index] = next == 0 ? 1 : next;
+  }
+
+private:
+  int slots;
+  std::vector<std::unique_ptr<T[]> > chunks;
+  std::vector<uint16_t> generations;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef __BRAIN_H_
+#define __BRAIN_H_
+
+#include "Network.h"
+#include "Genome.h"
+
+// the agent network: nine sensors and four memory cells in, five behaviors
+// and four memory cells out
+const int SENSOR_COUNT = 9;
+const int HIDDEN_SIZE = 8;
+const int BEHAVIOR_COUNT = 5;
+const int MEMORY_SIZE = 4;
+
+typedef Network<SENSOR_COUNT, HIDDEN_SIZE, BEHAVIOR_COUNT, MEMORY_SIZE> Brain;
+
+const int DNA_SIZE = Brain::DNA_SIZE;
+
+// genome precision, picked at build time: 32 (fp32), 16 (fp16) or 8 (int8)
+#ifndef GENOME_PRECISION
+#define GENOME_PRECISION 32
+#endif
+
+#if GENOME_PRECISION == 32
+typedef Genome<Brain, float> AgentGenome;
+#elif GENOME_PRECISION == 16
+typedef Genome<Brain, Half> AgentGenome;
+#elif GENOME_PRECISION == 8
+typedef Genome<Brain, int8_t> AgentGenome;
+#else
+#error "GENOME_PRECISION must be 32, 16 or 8"
+#endif
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef __GENOME_H_
+#define __GENOME_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include "Network.h"
+
+#if defined(__F16C__) || (defined(__AVX512VNNI__) && defined(__AVX512VL__) && defined(__AVX512BW__))
+#include <immintrin.h>
+#endif
+
+//
+// IEEE half precision
+//
+
+struct Half {
+  uint16_t bits;
+};
+
+inline uint16_t float_to_half_bits(float f) {
+#ifdef __F16C__
+  return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = x & 0x7fffff;
+  if (((x >> 23) & 0xff) == 0xff) {
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+  if (exponent >= 31) {
+    return sign | 0x7c00;
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    uint32_t h = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (h & 1))) {
+      h++;
+    }
+    return sign | h;
+  }
+  uint32_t h = sign | (exponent << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) {
+    h++;
+  }
+  return h;
+#endif
+}
+
+inline float half_bits_to_float(uint16_t h) {
+#ifdef __F16C__
+  return _cvtsh_ss(h);
+#else
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  int exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  uint32_t x;
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      x = sign;
+    } else {
+      exponent = 1;
+      while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        exponent--;
+      }
+      mantissa &= 0x3ff;
+      x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+  } else if (exponent == 31) {
+    x = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+#endif
+}
+
+inline void halves_to_floats(const Half *in, float *out, int n) {
+  int i = 0;
+#ifdef __F16C__
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = half_bits_to_float(in[i].bits);
+  }
+}
+
+//
+// int8 dot product, VNNI where available
+//
+
+template <int N>
+inline int32_t dot_i8(const int8_t *a, const int8_t *b) {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__) && defined(__AVX512BW__)
+  // dpbusd multiplies unsigned by signed bytes, so bias a into unsigned
+  // range and subtract the bias back out: (a + 128) . b - 128 . b
+  const __m128i offset = _mm_set1_epi8((char)0x80);
+  __m128i sum = _mm_setzero_si128();
+  __m128i bias = _mm_setzero_si128();
+  for (int i = 0; i < N; i += 16) {
+    __mmask16 mask = N - i >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (N - i)) - 1);
+    __m128i x = _mm_maskz_loadu_epi8(mask, a + i);
+    __m128i w = _mm_maskz_loadu_epi8(mask, b + i);
+    sum = _mm_dpbusd_epi32(sum, _mm_xor_si128(x, offset), w);
+    bias = _mm_dpbusd_epi32(bias, offset, w);
+  }
+  sum = _mm_sub_epi32(sum, bias);
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int32_t sum = 0;
+  Unroll<N>::apply([&](int i) { sum += (int32_t)a[i] * (int32_t)b[i]; });
+  return sum;
+#endif
+}
+
+inline int8_t quantize_i8(float x, float inverse_scale) {
+  float q = roundf(x * inverse_scale);
+  return (int8_t)(q > 127.0f ? 127.0f : q < -127.0f ? -127.0f : q);
+}
+
+//
+// Genome<Net, Gene> holds the DNA_SIZE genes of a Net in one of three
+// precisions. They all share one interface:
+//
+//   assign(dna)          set every gene from fp32 values
+//   decode(dna)          read every gene back as fp32
+//   get(i) / set(i, x)   one gene
+//   mutate(i, delta, u)  nudge one gene; u in [0, 1) dithers rounding
+//   mutated(i, x, ...)   what mutate() would make of gene i if it held x
+//   fits(i, x)           whether gene i can hold x without rescaling
+//   rounded(i, x)        what gene i would read back as after set(i, x)
+//   rescale()            refit any scales to the genes held now
+//   forward<Tanh>(...)   evaluate the network, under an Activation.h tanh
+//   gains(...)           the gains block as fp32
+//
+// DITHERED is set when mutate() makes use of u, so fp32 runs do not have
+// to draw it.
+//
+
+template <typename Net, typename Gene>
+struct Genome;
+
+template <typename Net>
+struct Genome<Net, float> {
+  enum { DITHERED = 0 };
+
+  float genes[Net::DNA_SIZE];
+
+  void assign(const float *dna) {
+    memcpy(genes, dna, sizeof(genes));
+  }
+
+  void decode(float *dna) const {
+    memcpy(dna, genes, sizeof(genes));
+  }
+
+  float get(int i) const {
+    return genes[i];
+  }
+
+  void set(int i, float x) {
+    genes[i] = x;
+  }
+
+  float mutated(int, float x, float delta, float) const {
+    return x + delta;
+  }
+
+  void mutate(int i, float delta, float u) {
+    genes[i] = mutated(i, genes[i], delta, u);
+  }
+
+  bool fits(int, float) const {
+    return true;
+  }
+
+  float rounded(int, float x) const {
+    return x;
+  }
+
+  void rescale() {
+  }
+
+  template <typename Tanh = TanhExact>
+  void forward(const float (&inputs)[Net::INPUTS],
+               float (&hidden)[Net::HIDDEN_SIZE],
+               float (&outputs)[Net::OUTPUTS]) const {
+    Net::template forward<Tanh>(genes, inputs, hidden, outputs);
+  }
+
+  void gains(float (&out)[Net::OUTPUTS]) const {
+    memcpy(out, Net::gains(genes), sizeof(out));
+  }
+};
+
+template <typename Net>
+struct Genome<Net, Half> {
+  enum { DITHERED = 0 };
+
+  Half genes[Net::DNA_SIZE];
+
+  void assign(const float *dna) {
+    for (int i = 0; i < Net::DNA_SIZE; i++) {
+      genes[i].bits = float_to_half_bits(dna[i]);
+    }
+  }
+
+  void decode(float *dna) const {
+    halves_to_floats(genes, dna, Net::DNA_SIZE);
+  }
+
+  float get(int i) const {
+    return half_bits_to_float(genes[i].bits);
+  }
+
+  void set(int i, float x) {
+    genes[i].bits = float_to_half_bits(x);
+  }
+
+  float mutated(int, float x, float delta, float) const {
+    return half_bits_to_float(float_to_half_bits(x + delta));
+  }
+
+  void mutate(int i, float delta, float u) {
+    set(i, mutated(i, get(i), delta, u));
+  }
+
+  bool fits(int, float) const {
+    return true;
+  }
+
+  float rounded(int, float x) const {
+    return half_bits_to_float(float_to_half_bits(x));
+  }
+
+  void rescale() {
+  }
+
+  template <typename Tanh = TanhExact>
+  void forward(const float (&inputs)[Net::INPUTS],
+               float (&hidden)[Net::HIDDEN_SIZE],
+               float (&outputs)[Net::OUTPUTS]) const {
+    float dna[Net::DNA_SIZE];
+    halves_to_floats(genes, dna, Net::GAINS_OFFSET);
+    Net::template forward<Tanh>(dna, inputs, hidden, outputs);
+  }
+
+  void gains(float (&out)[Net::OUTPUTS]) const {
+    halves_to_floats(genes + Net::GAINS_OFFSET, out, Net::GAINS_SIZE);
+  }
+};
+
+// symmetric int8 with one scale per block; activations are quantized on the
+// fly so both layers run as integer dot products
+template <typename Net>
+struct Genome<Net, int8_t> {
+  enum { DITHERED = 1 };
+
+  int8_t genes[Net::DNA_SIZE];
+  float scales[Net::BLOCKS];
+
+  void assign(const float *dna) {
+    for (int b = 0; b < Net::BLOCKS; b++) {
+      assign_block(b, dna + Net::block_offset(b));
+    }
+  }
+
+  void decode(float *dna) const {
+    for (int i = 0; i < Net::DNA_SIZE; i++) {
+      dna[i] = get(i);
+    }
+  }
+
+  float get(int i) const {
+    return genes[i] * scales[Net::block_of(i)];
+  }
+
+  void set(int i, float x) {
+    int b = Net::block_of(i);
+    if (fabsf(x) > 127.0f * scales[b]) {
+      // out of range for this block, so widen its scale
+      float block[Net::DNA_SIZE];
+      int offset = Net::block_offset(b);
+      for (int j = 0; j < Net::block_size(b); j++) {
+        block[j] = get(offset + j);
+      }
+      block[i - offset] = x;
+      assign_block(b, block);
+    } else {
+      genes[i] = quantize_i8(x, 1.0f / scales[b]);
+    }
+  }
+
+  // mutations are usually smaller than one quantization step, so they are
+  // rounded stochastically to keep them from all rounding to zero
+  float mutated(int i, float x, float delta, float u) const {
+    float scale = scales[Net::block_of(i)];
+    float moved = roundf(x / scale) + floorf(delta / scale + u);
+    if (moved > 127.0f || moved < -127.0f) {
+      return x + delta;
+    }
+    return moved * scale;
+  }
+
+  void mutate(int i, float delta, float u) {
+    set(i, mutated(i, get(i), delta, u));
+  }
+
+  bool fits(int i, float x) const {
+    return fabsf(x) <= 127.0f * scales[Net::block_of(i)];
+  }
+
+  float rounded(int i, float x) const {
+    float scale = scales[Net::block_of(i)];
+    return fits(i, x) ? quantize_i8(x, 1.0f / scale) * scale : x;
+  }
+
+  // set() only ever widens a block's scale, so an outlier long since
+  // mutated away would go on costing its block precision. This refits the
+  // scale of any block whose largest gene now uses less than half its
+  // range; requantizing costs a rounding, so only for a bit or more back.
+  void rescale() {
+    for (int b = 0; b < Net::BLOCKS; b++) {
+      int offset = Net::block_offset(b);
+      int size = Net::block_size(b);
+      int max_q = 0;
+      for (int j = 0; j < size; j++) {
+        max_q = std::max(max_q, std::abs((int)genes[offset + j]));
+      }
+      if (max_q >= 64) {
+        continue;
+      }
+      float block[Net::DNA_SIZE];
+      for (int j = 0; j < size; j++) {
+        block[j] = get(offset + j);
+      }
+      assign_block(b, block);
+    }
+  }
+
+  template <typename Tanh = TanhExact>
+  void forward(const float (&inputs)[Net::INPUTS],
+               float (&hidden)[Net::HIDDEN_SIZE],
+               float (&outputs)[Net::OUTPUTS]) const {
+    float input_max = 0.0f;
+    for (int i = 0; i < Net::INPUTS; i++) {
+      input_max = fmaxf(input_max, fabsf(inputs[i]));
+    }
+    float input_scale = input_max > 0.0f ? input_max / 127.0f : 1.0f;
+    int8_t xq[Net::INPUTS];
+    for (int i = 0; i < Net::INPUTS; i++) {
+      xq[i] = quantize_i8(inputs[i], 1.0f / input_scale);
+    }
+    Tanh activate;
+    const int8_t *hw = genes + Net::HIDDEN_WEIGHTS_OFFSET;
+    float hidden_scale = input_scale * scales[0];
+    int8_t hq[Net::HIDDEN_SIZE];
+    Unroll<Net::HIDDEN_SIZE>::apply([&](int j) {
+      hidden[j] = activate(dot_i8<Net::INPUTS>(xq, hw + j * Net::INPUTS) * hidden_scale);
+      hq[j] = quantize_i8(hidden[j], 127.0f);
+    });
+    const int8_t *ow = genes + Net::OUTPUT_WEIGHTS_OFFSET;
+    float output_scale = scales[1] / 127.0f;
+    Unroll<Net::OUTPUTS>::apply([&](int k) {
+      outputs[k] = activate(dot_i8<Net::HIDDEN_SIZE>(hq, ow + k * Net::HIDDEN_SIZE) * output_scale);
+    });
+  }
+
+  void gains(float (&out)[Net::OUTPUTS]) const {
+    for (int k = 0; k < Net::OUTPUTS; k++) {
+      out[k] = genes[Net::GAINS_OFFSET + k] * scales[2];
+    }
+  }
+
+private:
+  void assign_block(int b, const float *values) {
+    int offset = Net::block_offset(b);
+    int size = Net::block_size(b);
+    float max_abs = 0.0f;
+    for (int j = 0; j < size; j++) {
+      max_abs = fmaxf(max_abs, fabsf(values[j]));
+    }
+    scales[b] = max_abs > 0.0f ? max_abs / 127.0f : 1.0f / 127.0f;
+    for (int j = 0; j < size; j++) {
+      genes[offset + j] = quantize_i8(values[j], 1.0f / scales[b]);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef __GENOME_BANK_H_
+#define __GENOME_BANK_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Brain.h"
+#include "Senses.h"
+
+// One banked genome, as fp32 whatever the build's precision, with where it
+// came from.
+struct BankRecord {
+  uint64_t id;    // in its island's lineage
+  int32_t island;
+  int32_t frame;  // when it was banked
+  int32_t born;
+  int32_t score;
+  float hue;
+  float genes[DNA_SIZE];
+};
+
+struct BankHeader {
+  enum { MAGIC = 0x534c4f50 };         // POLS
+  enum { SIGNED_MAGIC = 0x424c4f50 };  // POLB, banks with no senses stored
+
+  uint32_t magic;
+  uint32_t dna_size;  // a bank only seeds networks of its own shape
+  uint32_t record_size;
+  uint32_t signature;  // and wired as they were, by Senses::signature()
+  Senses senses;       // the whole layout, which POLB banks do not have
+
+  // whether the records after this header are genomes of this build
+  bool valid() const {
+    return (magic == MAGIC || magic == SIGNED_MAGIC) && dna_size == DNA_SIZE &&
+           record_size == sizeof(BankRecord);
+  }
+
+  // the bytes before the first record
+  size_t size() const {
+    return magic == MAGIC ? sizeof(BankHeader) : offsetof(BankHeader, senses);
+  }
+
+  // whether a bank with this header holds genomes for networks wired so;
+  // the first banks were signed 0, and hold the standard layout
+  bool holds(uint32_t wired) const {
+    return valid() && (signature ? signature : Senses::standard().signature()) == wired;
+  }
+
+  // the layout the genomes were evolved under, if the bank can say
+  bool layout(Senses &out) const {
+    if (magic == MAGIC) {
+      out = senses;
+      return valid();
+    }
+    out = Senses::standard();
+    return holds(out.signature());
+  }
+};
+
+// A genome bank is a header and then records of a fixed size, so that it
+// can be appended to by a running sim and mapped as an array for seeding.
+// Records go in with one write() to a file opened for appending, so several
+// islands can share a bank without tearing each other's records.
+class BankWriter {
+public:
+  BankWriter() : fd(-1) {
+  }
+
+  ~BankWriter() {
+    close();
+  }
+
+  // appends to path, or with truncate starts it over, for genomes of
+  // networks wired by these senses
+  bool open(const std::string &path, const Senses &senses, bool truncate = false) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+    if (fd < 0) {
+      printf("bank: could not open %s\n", path.c_str());
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+      BankHeader header = { BankHeader::MAGIC, DNA_SIZE, sizeof(BankRecord), senses.signature(), senses };
+      if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+        close();
+        return false;
+      }
+      return true;
+    }
+    BankHeader header;
+    if (pread(fd, &header, sizeof(header), 0) < (ssize_t)offsetof(BankHeader, senses) ||
+        !header.holds(senses.signature())) {
+      printf("bank: %s holds other genomes\n", path.c_str());
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  bool is_open() const {
+    return fd >= 0;
+  }
+
+  void close() {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  void append(const BankRecord &record) {
+    if (fd >= 0 && write(fd, &record, sizeof(record)) != sizeof(record)) {
+      printf("bank: short write\n");
+    }
+  }
+
+private:
+  int fd;
+};
+
+// A bank mapped read only, as it was when opened.
+class BankReader {
+public:
+  BankReader() : memory(0), bytes(0), records(0), count(0) {
+  }
+
+  ~BankReader() {
+    close();
+  }
+
+  // a bank of genomes for networks wired by the senses with this signature
+  bool open(const std::string &path, uint32_t senses) {
+    if (!open(path)) {
+      return false;
+    }
+    if (!header().holds(senses)) {
+      printf("bank: %s holds other genomes\n", path.c_str());
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  // a bank of genomes for networks of this build, wired however layout()
+  // says
+  bool open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      printf("bank: could not open %s\n", path.c_str());
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < offsetof(BankHeader, senses)) {
+      printf("bank: %s is not a bank\n", path.c_str());
+      ::close(fd);
+      return false;
+    }
+    bytes = st.st_size;
+    void *mapped = mmap(0, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      printf("bank: could not map %s\n", path.c_str());
+      return false;
+    }
+    memory = (const char *)mapped;
+    if (!header().valid() || bytes < header().size()) {
+      printf("bank: %s holds other genomes\n", path.c_str());
+      close();
+      return false;
+    }
+    records = header().size();
+    // a record still being appended is left out
+    count = (int)((bytes - records) / sizeof(BankRecord));
+    return true;
+  }
+
+  // the layout the bank's genomes were evolved under; false for a POLB
+  // bank signed with one it did not store
+  bool layout(Senses &out) const {
+    return memory && header().layout(out);
+  }
+
+  void close() {
+    if (memory) {
+      munmap((void *)memory, bytes);
+      memory = 0;
+    }
+    bytes = 0;
+    records = 0;
+    count = 0;
+  }
+
+  int size() const {
+    return count;
+  }
+
+  // reads as though the bank held only its first n records
+  void limit(int n) {
+    count = std::min(count, n);
+  }
+
+  const BankRecord &operator[](int i) const {
+    return ((const BankRecord *)(memory + records))[i];
+  }
+
+private:
+  const char *memory;
+  size_t bytes;
+  size_t records;  // offset of the first record
+  int count;
+
+  // only the fields before senses are there in a POLB bank
+  const BankHeader &header() const {
+    return *(const BankHeader *)memory;
+  }
+};
+
+#endif
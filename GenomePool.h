@@ -0,0 +1,373 @@
+#ifndef __GENOME_POOL_H_
+#define __GENOME_POOL_H_
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include "Brain.h"
+
+typedef int GenomeId;
+
+struct GeneEdit {
+  uint16_t index;
+  float value;
+};
+
+// Refcounted genomes shared by agents and records.
+//
+// A genome is stored either dense, as a whole AgentGenome, or as a delta: a
+// dense base plus a sorted list of the genes that differ from it. A child of
+// a delta folds its own edits into its parent's, so a delta is always one hop
+// from its base, and once the edits outgrow MAX_DELTA the child is
+// materialized into a dense genome instead.
+//
+// Every genome carries an additive hash of its contents, which is the same
+// whichever way it is stored, so genomes dedup across both forms and
+// distinct() is an exact count of different live genomes.
+//
+// Agents think with whole genomes, so an agent holds its genome for life.
+// The first hold of a delta expands it in place: the dense copy every agent
+// sharing it reads takes the place of its edits, and the last let_go()
+// packs it back into edits against its base. A live agent's genome costs
+// one dense genome, as a private copy did, and only records and other
+// references that just read genes pay for edits.
+class GenomePool {
+public:
+  // past half the size of a dense genome a delta is not worth its lookups
+  enum { MAX_DELTA = sizeof(AgentGenome) / sizeof(GeneEdit) / 2 };
+
+  GenomePool() : live(0) {
+  }
+
+  // a reference to a genome equal to this one
+  GenomeId acquire(const AgentGenome &genome) {
+    uint64_t hash = 0;
+    for (int i = 0; i < DNA_SIZE; i++) {
+      hash += gene_hash(i, genome.get(i));
+    }
+    auto range = by_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (equals(it->second, genome)) {
+        retain(it->second);
+        return it->second;
+      }
+    }
+    GenomeId id = new_entry(hash);
+    entries[id].dense = new_dense(genome);
+    return id;
+  }
+
+  // a reference to parent with edits applied; edits are sorted by index
+  GenomeId derive(GenomeId parent, const GeneEdit *edits, int count) {
+    const Entry &p = entries[parent];
+    GenomeId base = p.base < 0 ? parent : p.base;
+    const AgentGenome &b = denses[entries[base].dense];
+    GeneEdit held[MAX_DELTA];
+    const GeneEdit *parent_edits = 0;
+    int parent_count = 0;
+    if (p.base >= 0 && p.dense >= 0) {
+      parent_edits = held;
+      parent_count = diff(denses[p.dense], b, held);
+    } else if (p.base >= 0) {
+      parent_edits = &edit_blocks[p.edits * MAX_DELTA];
+      parent_count = p.edit_count;
+    }
+
+    // merge the parent's edits with the new ones, dropping any that no
+    // longer differ from the base
+    GeneEdit merged[DNA_SIZE];
+    int n = 0;
+    bool fits = true;
+    uint64_t hash = entries[base].hash;
+    for (int i = 0, j = 0; i < parent_count || j < count;) {
+      GeneEdit e;
+      if (j >= count || (i < parent_count && parent_edits[i].index < edits[j].index)) {
+        e = parent_edits[i++];
+      } else {
+        if (i < parent_count && parent_edits[i].index == edits[j].index) {
+          i++;
+        }
+        e = edits[j++];
+      }
+      // stored as the base's precision would hold it, so a delta and the
+      // same genome made dense compare and hash alike
+      float was = b.get(e.index);
+      if (b.fits(e.index, e.value)) {
+        e.value = b.rounded(e.index, e.value);
+      } else {
+        fits = false;
+      }
+      if (e.value == was) {
+        continue;
+      }
+      hash += gene_hash(e.index, e.value) - gene_hash(e.index, was);
+      merged[n++] = e;
+    }
+
+    if (n == 0) {
+      retain(base);
+      return base;
+    }
+    if (!fits || n > MAX_DELTA) {
+      AgentGenome genome = b;
+      for (int i = 0; i < n; i++) {
+        genome.set(merged[i].index, merged[i].value);
+      }
+      // a new dense genome is where scales widened for outliers are won back
+      genome.rescale();
+      return acquire(genome);
+    }
+
+    auto range = by_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (equals(it->second, base, merged, n)) {
+        retain(it->second);
+        return it->second;
+      }
+    }
+    GenomeId id = new_entry(hash);
+    int block = new_edit_block();
+    Entry &entry = entries[id];
+    entry.base = base;
+    entry.edits = block;
+    entry.edit_count = n;
+    memcpy(&edit_blocks[entry.edits * MAX_DELTA], merged, n * sizeof(GeneEdit));
+    retain(base);
+    return id;
+  }
+
+  void retain(GenomeId id) {
+    entries[id].refs++;
+  }
+
+  void release(GenomeId id) {
+    if (id < 0) {
+      return;
+    }
+    Entry &entry = entries[id];
+    assert(entry.refs > 0);
+    if (--entry.refs > 0) {
+      return;
+    }
+    assert(entry.holds == 0);
+    auto range = by_hash.equal_range(entry.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == id) {
+        by_hash.erase(it);
+        break;
+      }
+    }
+    GenomeId base = entry.base;
+    if (entry.dense >= 0) {
+      free_denses.push_back(entry.dense);
+    } else {
+      free_edit_blocks.push_back(entry.edits);
+    }
+    free_entries.push_back(id);
+    live--;
+    release(base);
+  }
+
+  float get(GenomeId id, int i) const {
+    const Entry &entry = entries[id];
+    if (entry.dense >= 0) {
+      return denses[entry.dense].get(i);
+    }
+    const GeneEdit *edits = &edit_blocks[entry.edits * MAX_DELTA];
+    int lo = 0, hi = entry.edit_count;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (edits[mid].index < i) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lo < entry.edit_count && edits[lo].index == i) {
+      return edits[lo].value;
+    }
+    return denses[entries[entry.base].dense].get(i);
+  }
+
+  // what a mutation of gene i would make of it, in the genome's own precision
+  float mutated(GenomeId id, int i, float delta, float u) const {
+    const Entry &entry = entries[id];
+    const AgentGenome &b = denses[entries[entry.base < 0 ? id : entry.base].dense];
+    return b.mutated(i, get(id, i), delta, u);
+  }
+
+  // An agent's hold on its genome, which must also be retained; a delta is
+  // expanded on its first hold only, and its edits freed while it is.
+  void hold(GenomeId id) {
+    if (id < 0) {
+      return;
+    }
+    Entry &entry = entries[id];
+    if (entry.base < 0 || entry.holds++ > 0) {
+      return;
+    }
+    int slot = new_dense(denses[entries[entry.base].dense]);
+    AgentGenome &genome = denses[slot];
+    const GeneEdit *edits = &edit_blocks[entry.edits * MAX_DELTA];
+    for (int i = 0; i < entry.edit_count; i++) {
+      genome.set(edits[i].index, edits[i].value);
+    }
+    free_edit_blocks.push_back(entry.edits);
+    entry.edits = -1;
+    entry.dense = slot;
+  }
+
+  void let_go(GenomeId id) {
+    if (id < 0) {
+      return;
+    }
+    Entry &entry = entries[id];
+    if (entry.base < 0) {
+      return;
+    }
+    assert(entry.holds > 0);
+    if (--entry.holds > 0) {
+      return;
+    }
+    entry.edits = new_edit_block();
+    entry.edit_count = diff(denses[entry.dense], denses[entries[entry.base].dense], &edit_blocks[entry.edits * MAX_DELTA]);
+    free_denses.push_back(entry.dense);
+    entry.dense = -1;
+  }
+
+  // a held genome as a whole; valid until the next acquire(), derive() or
+  // hold()
+  const AgentGenome &expanded(GenomeId id) const {
+    const Entry &entry = entries[id];
+    assert(entry.dense >= 0);
+    return denses[entry.dense];
+  }
+
+  // number of different genomes alive
+  int distinct() const {
+    return live;
+  }
+
+  // dense slots in use, held deltas among them
+  int dense_count() const {
+    return (int)(denses.size() - free_denses.size());
+  }
+
+  size_t bytes() const {
+    return entries.capacity() * sizeof(Entry)
+      + denses.capacity() * sizeof(AgentGenome)
+      + edit_blocks.capacity() * sizeof(GeneEdit);
+  }
+
+private:
+  struct Entry {
+    int refs;
+    int dense;      // slot in denses, or -1 for a delta not held
+    GenomeId base;  // dense genome a delta applies to, or -1
+    int edits;      // block in edit_blocks for a delta not held, or -1
+    int edit_count;
+    int holds;      // agents thinking with a delta
+    uint64_t hash;
+  };
+
+  std::vector<Entry> entries;
+  std::vector<GenomeId> free_entries;
+  std::vector<AgentGenome> denses;
+  std::vector<int> free_denses;
+  std::vector<GeneEdit> edit_blocks;
+  std::vector<int> free_edit_blocks;
+  std::unordered_multimap<uint64_t, GenomeId> by_hash;
+  int live;
+
+  static uint64_t gene_hash(int i, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    // splitmix64 finalizer
+    uint64_t z = ((uint64_t)i << 32 | bits) + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  GenomeId new_entry(uint64_t hash) {
+    GenomeId id;
+    if (free_entries.empty()) {
+      id = (GenomeId)entries.size();
+      entries.push_back(Entry());
+    } else {
+      id = free_entries.back();
+      free_entries.pop_back();
+    }
+    Entry &entry = entries[id];
+    entry.refs = 1;
+    entry.dense = -1;
+    entry.base = -1;
+    entry.edits = -1;
+    entry.edit_count = 0;
+    entry.holds = 0;
+    entry.hash = hash;
+    by_hash.insert(std::make_pair(hash, id));
+    live++;
+    return id;
+  }
+
+  int new_dense(const AgentGenome &genome) {
+    if (free_denses.empty()) {
+      denses.push_back(genome);
+      return (int)denses.size() - 1;
+    }
+    int slot = free_denses.back();
+    free_denses.pop_back();
+    denses[slot] = genome;
+    return slot;
+  }
+
+  int new_edit_block() {
+    if (free_edit_blocks.empty()) {
+      edit_blocks.resize(edit_blocks.size() + MAX_DELTA);
+      return (int)(edit_blocks.size() / MAX_DELTA) - 1;
+    }
+    int block = free_edit_blocks.back();
+    free_edit_blocks.pop_back();
+    return block;
+  }
+
+  // the genes where genome differs from base, which for a held delta are
+  // the edits it was expanded from
+  static int diff(const AgentGenome &genome, const AgentGenome &base, GeneEdit *edits) {
+    int n = 0;
+    for (int i = 0; i < DNA_SIZE; i++) {
+      float value = genome.get(i);
+      if (value != base.get(i)) {
+        assert(n < MAX_DELTA);
+        GeneEdit e = { (uint16_t)i, value };
+        edits[n++] = e;
+      }
+    }
+    return n;
+  }
+
+  bool equals(GenomeId id, const AgentGenome &genome) const {
+    for (int i = 0; i < DNA_SIZE; i++) {
+      if (get(id, i) != genome.get(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool equals(GenomeId id, GenomeId base, const GeneEdit *edits, int count) const {
+    const AgentGenome &b = denses[entries[base].dense];
+    for (int i = 0, j = 0; i < DNA_SIZE; i++) {
+      float value = j < count && edits[j].index == i ? edits[j++].value : b.get(i);
+      if (get(id, i) != value) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef __ISLANDS_H_
+#define __ISLANDS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Brain.h"
+
+// A genome on its way from one island to another.
+struct Migrant {
+  float genes[DNA_SIZE];
+  float hue;
+};
+
+// A ring of migrants with one sender and one receiver. The sender only
+// moves tail and the receiver only head, so neither ever waits for the
+// other: a full box turns migrants away and an empty one has none to give.
+struct Mailbox {
+  enum { SLOTS = 16 };
+
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  Migrant slots[SLOTS];
+
+  bool send(const Migrant &migrant) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == SLOTS) {
+      return false;
+    }
+    slots[t % SLOTS] = migrant;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool receive(Migrant &migrant) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    migrant = slots[h % SLOTS];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+enum Topology {
+  TOPOLOGY_RING,  // each island sends to the next
+  TOPOLOGY_FULL   // each island sends to every other
+};
+
+// Island-model evolution. Every island is a forked copy of the sim stepping
+// its own world on its own core: the sim keeps its world in globals, so a
+// process of its own gives each island a world of its own. All the islands
+// share is one anonymous mapping, made before forking, holding a mailbox for
+// every ordered pair of islands and a quit flag. No island ever waits on
+// another.
+class Archipelago {
+public:
+  Archipelago() : count(1), index(0), parent(0), header(0), boxes(0), bytes(0) {
+  }
+
+  ~Archipelago() {
+    if (header) {
+      munmap(header, bytes);
+    }
+  }
+
+  // Forks islands - 1 children. Returns in every process, which is then
+  // island() of size(); the parent is island 0. With one island, or when
+  // the mapping fails, there is nothing to fork and the run goes on alone.
+  bool create(int islands) {
+    if (islands <= 1) {
+      return true;
+    }
+    bytes = sizeof(Header) + sizeof(Mailbox) * islands * islands;
+    void *memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    if (memory == MAP_FAILED) {
+      printf("islands: could not map %zu bytes\n", bytes);
+      return false;
+    }
+    header = (Header *)memory;
+    header->quit.store(0, std::memory_order_relaxed);
+    boxes = (Mailbox *)(header + 1);
+    for (int b = 0; b < islands * islands; b++) {
+      boxes[b].head.store(0, std::memory_order_relaxed);
+      boxes[b].tail.store(0, std::memory_order_relaxed);
+    }
+    count = islands;
+    parent = getpid();
+    for (int i = 1; i < islands; i++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        printf("islands: could not fork island %d\n", i);
+        count = i;
+        break;
+      }
+      if (pid == 0) {
+        index = i;
+        children.clear();
+        return true;
+      }
+      children.push_back(pid);
+    }
+    return true;
+  }
+
+  int size() const {
+    return count;
+  }
+
+  int island() const {
+    return index;
+  }
+
+  // the islands this one sends migrants to
+  void destinations(Topology topology, std::vector<int> &out) const {
+    out.clear();
+    if (count <= 1) {
+      return;
+    }
+    if (topology == TOPOLOGY_RING) {
+      out.push_back((index + 1) % count);
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      if (i != index) {
+        out.push_back(i);
+      }
+    }
+  }
+
+  Mailbox &outbox(int to) {
+    return boxes[index * count + to];
+  }
+
+  Mailbox &inbox(int from) {
+    return boxes[from * count + index];
+  }
+
+  void quit() {
+    if (header) {
+      header->quit.store(1, std::memory_order_relaxed);
+    }
+  }
+
+  // true once any island has quit, or the parent has gone
+  bool quitting() const {
+    return header && (header->quit.load(std::memory_order_relaxed) || (index > 0 && getppid() != parent));
+  }
+
+  // the parent's side of quitting: waits for every other island to finish
+  void join() {
+    quit();
+    for (size_t c = 0; c < children.size(); c++) {
+      waitpid(children[c], 0, 0);
+    }
+    children.clear();
+  }
+
+private:
+  struct Header {
+    std::atomic<int> quit;
+    char pad[60];  // keeps the flag off the first mailbox's cache line
+  };
+
+  int count;
+  int index;
+  pid_t parent;
+  Header *header;
+  Mailbox *boxes;  // from * count + to
+  size_t bytes;
+  std::vector<pid_t> children;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef __JOURNAL_H_
+#define __JOURNAL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "Islands.h"
+#include "Parameters.h"
+#include "Senses.h"
+
+// Everything that steers a run besides its seed and its senses, stamped
+// with the frame it happened in: config changes, food cleared from the
+// keyboard and migrants arriving from other islands. The seed and the
+// sensor and behavior layout, fixed for the run, are in the header. The
+// same seed and the same journal take the sim down the same path, so a run
+// can be replayed headless at full speed.
+// A hash of the world every CHECK_INTERVAL frames, and at the end, lets a
+// replay show that it has.
+//
+// Entries of a frame are written in the order step() meets them, and a
+// replay takes them back at the same places.
+enum JournalKind {
+  JOURNAL_CONFIG,
+  JOURNAL_CLEAR,
+  JOURNAL_MIGRANT,
+  JOURNAL_CHECK,
+  JOURNAL_END
+};
+
+struct JournalEntry {
+  int32_t frame;
+  int32_t kind;
+  union {
+    Parameters parameters;
+    Migrant migrant;
+    uint64_t hash;
+  };
+};
+
+struct JournalHeader {
+  enum { MAGIC = 0x4a4c4f50 };  // POLJ
+
+  uint32_t magic;
+  uint32_t parameters_size;  // a journal only replays on a build that agrees
+  uint32_t migrant_size;
+  int32_t island;
+  uint64_t seed;
+  // the seed bank may have grown since, when it is also the genome bank,
+  // so a replay draws from the records the run saw and no more
+  int32_t seed_records;
+  uint32_t senses_size;
+  Senses senses;  // the layout the run's agents were wired with
+};
+
+inline size_t journal_payload_size(int kind) {
+  switch (kind) {
+  case JOURNAL_CONFIG:
+    return sizeof(Parameters);
+  case JOURNAL_MIGRANT:
+    return sizeof(Migrant);
+  case JOURNAL_CHECK:
+  case JOURNAL_END:
+    return sizeof(uint64_t);
+  default:
+    return 0;
+  }
+}
+
+class JournalWriter {
+public:
+  enum { CHECK_INTERVAL = 10000 };
+
+  JournalWriter() : file(0) {
+  }
+
+  ~JournalWriter() {
+    close();
+  }
+
+  bool open(const std::string &path, uint64_t seed, int island, int seed_records, const Senses &senses) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+      printf("journal: could not open %s\n", path.c_str());
+      return false;
+    }
+    JournalHeader header = { JournalHeader::MAGIC, sizeof(Parameters), sizeof(Migrant), island, seed, seed_records,
+                             sizeof(Senses), senses };
+    fwrite(&header, sizeof(header), 1, file);
+    return true;
+  }
+
+  void close() {
+    if (file) {
+      fclose(file);
+      file = 0;
+    }
+  }
+
+  void config(int frame, const Parameters &parameters) {
+    JournalEntry entry;
+    entry.parameters = parameters;
+    write(frame, JOURNAL_CONFIG, entry);
+  }
+
+  void clear(int frame) {
+    JournalEntry entry;
+    write(frame, JOURNAL_CLEAR, entry);
+  }
+
+  void migrant(int frame, const Migrant &migrant) {
+    JournalEntry entry;
+    entry.migrant = migrant;
+    write(frame, JOURNAL_MIGRANT, entry);
+  }
+
+  // checks reach the disk, so a run that dies can be replayed to its last
+  void check(int frame, uint64_t hash) {
+    JournalEntry entry;
+    entry.hash = hash;
+    write(frame, JOURNAL_CHECK, entry);
+    if (file) {
+      fflush(file);
+    }
+  }
+
+  // frame is the first one the run did not step
+  void end(int frame, uint64_t hash) {
+    JournalEntry entry;
+    entry.hash = hash;
+    write(frame, JOURNAL_END, entry);
+    close();
+  }
+
+private:
+  FILE *file;
+
+  void write(int frame, int kind, JournalEntry &entry) {
+    if (!file) {
+      return;
+    }
+    entry.frame = frame;
+    entry.kind = kind;
+    fwrite(&entry, offsetof(JournalEntry, hash), 1, file);
+    fwrite(&entry.hash, journal_payload_size(kind), 1, file);
+  }
+};
+
+class JournalReader {
+public:
+  JournalReader() : file(0), has_next(false) {
+  }
+
+  ~JournalReader() {
+    if (file) {
+      fclose(file);
+    }
+  }
+
+  bool open(const std::string &path) {
+    file = fopen(path.c_str(), "rb");
+    if (!file) {
+      printf("journal: could not open %s\n", path.c_str());
+      return false;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != JournalHeader::MAGIC) {
+      printf("journal: %s is not a journal\n", path.c_str());
+      return false;
+    }
+    if (header.parameters_size != sizeof(Parameters) || header.migrant_size != sizeof(Migrant) ||
+        header.senses_size != sizeof(Senses)) {
+      printf("journal: %s was written by a different build\n", path.c_str());
+      return false;
+    }
+    advance();
+    return true;
+  }
+
+  uint64_t seed() const {
+    return header.seed;
+  }
+
+  int island() const {
+    return header.island;
+  }
+
+  int seed_records() const {
+    return header.seed_records;
+  }
+
+  const Senses &senses() const {
+    return header.senses;
+  }
+
+  // the next entry, or 0 once they have all been taken
+  const JournalEntry *peek() const {
+    return has_next ? &next : 0;
+  }
+
+  void pop() {
+    advance();
+  }
+
+private:
+  FILE *file;
+  JournalHeader header;
+  JournalEntry next;
+  bool has_next;
+
+  // a torn entry at the end of a journal that was never closed is dropped
+  void advance() {
+    has_next = fread(&next, offsetof(JournalEntry, hash), 1, file) == 1 &&
+               next.kind >= JOURNAL_CONFIG && next.kind <= JOURNAL_END &&
+               fread(&next.hash, journal_payload_size(next.kind), 1, file) == (journal_payload_size(next.kind) ? 1u : 0u);
+  }
+};
+
+#endif
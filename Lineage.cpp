@@ -0,0 +1,256 @@
+#include "Lineage.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+// ColumnTable
+//
+
+ColumnTable::ColumnTable(const std::string &path, const std::vector<int> &widths, int chunk_rows, int resident_chunks)
+  : path(path), widths(widths), chunk_rows(chunk_rows), resident_chunks(std::max(1, resident_chunks)),
+    row_count(0), first_resident(0), fd(-1) {
+  size_t offset = 0;
+  for (size_t c = 0; c < widths.size(); c++) {
+    column_offsets.push_back(offset);
+    offset += (size_t)widths[c] * chunk_rows;
+  }
+  chunk_bytes = offset;
+}
+
+ColumnTable::~ColumnTable() {
+  for (size_t i = 0; i < chunks.size(); i++) {
+    free(chunks[i]);
+  }
+  for (size_t i = 0; i < free_blocks.size(); i++) {
+    free(free_blocks[i]);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+void ColumnTable::append(const void *const *values) {
+  size_t chunk = row_count / chunk_rows;
+  size_t r = row_count % chunk_rows;
+  if (chunk == chunks.size()) {
+    if ((int)(chunks.size() - first_resident) >= resident_chunks) {
+      spill_oldest();
+    }
+    char *block;
+    if (free_blocks.empty()) {
+      block = (char *)malloc(chunk_bytes);
+      assert(block != 0);
+    } else {
+      block = free_blocks.back();
+      free_blocks.pop_back();
+    }
+    chunks.push_back(block);
+  }
+  char *block = chunks[chunk];
+  for (size_t c = 0; c < widths.size(); c++) {
+    memcpy(block + column_offsets[c] + r * widths[c], values[c], widths[c]);
+  }
+  row_count++;
+}
+
+void ColumnTable::get(uint64_t row, int column, void *value) {
+  get_range(row, 1, column, value);
+}
+
+void ColumnTable::get_range(uint64_t first, uint64_t count, int column, void *out) {
+  assert(first + count <= row_count);
+  char *dst = (char *)out;
+  int width = widths[column];
+  while (count > 0) {
+    size_t chunk = first / chunk_rows;
+    size_t r = first % chunk_rows;
+    size_t n = std::min<uint64_t>(count, chunk_rows - r);
+    size_t offset = column_offsets[column] + r * width;
+    if (chunks[chunk]) {
+      memcpy(dst, chunks[chunk] + offset, n * width);
+    } else {
+      ssize_t read = pread(fd, dst, n * width, (off_t)(chunk * chunk_bytes + offset));
+      assert(read == (ssize_t)(n * width));
+    }
+    dst += n * width;
+    first += n;
+    count -= n;
+  }
+}
+
+void ColumnTable::set(uint64_t row, int column, const void *value) {
+  assert(row < row_count);
+  size_t chunk = row / chunk_rows;
+  int width = widths[column];
+  size_t offset = column_offsets[column] + (row % chunk_rows) * width;
+  if (chunks[chunk]) {
+    memcpy(chunks[chunk] + offset, value, width);
+  } else {
+    ssize_t written = pwrite(fd, value, width, (off_t)(chunk * chunk_bytes + offset));
+    assert(written == (ssize_t)width);
+  }
+}
+
+void ColumnTable::flush() {
+  if (!open_file()) {
+    return;
+  }
+  for (size_t chunk = first_resident; chunk < chunks.size(); chunk++) {
+    ssize_t written = pwrite(fd, chunks[chunk], chunk_bytes, (off_t)(chunk * chunk_bytes));
+    if (written != (ssize_t)chunk_bytes) {
+      printf("lineage: could not write %s\n", path.c_str());
+      return;
+    }
+  }
+}
+
+void ColumnTable::rename(const std::string &path) {
+  assert(fd < 0);
+  this->path = path;
+}
+
+bool ColumnTable::open_file() {
+  if (fd < 0) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      printf("lineage: could not open %s, keeping it in memory\n", path.c_str());
+    }
+  }
+  return fd >= 0;
+}
+
+void ColumnTable::spill_oldest() {
+  char *block = chunks[first_resident];
+  if (!open_file() ||
+      pwrite(fd, block, chunk_bytes, (off_t)(first_resident * chunk_bytes)) != (ssize_t)chunk_bytes) {
+    // nowhere to spill to, so stop trying and grow in memory
+    resident_chunks = INT_MAX;
+    return;
+  }
+  chunks[first_resident] = 0;
+  free_blocks.push_back(block);
+  first_resident++;
+}
+
+//
+// Lineage
+//
+
+// a birth's death is its row in the death table plus one, or 0 while alive
+enum { BIRTH_PARENT, BIRTH_FRAME, BIRTH_MUTATIONS, BIRTH_DEATH };
+enum { DEATH_ID, DEATH_FRAME, DEATH_AGE, DEATH_SCORE, DEATH_CAUSE };
+
+// rows read at a time by scans
+const int SCAN_ROWS = 4096;
+
+Lineage::Lineage(const std::string &path, int chunk_rows, int resident_chunks)
+  : path(path),
+    birth_table(path + ".births", { 8, 8, 2, 8 }, chunk_rows, resident_chunks),
+    death_table(path + ".deaths", { 8, 8, 4, 4, 1 }, chunk_rows, resident_chunks),
+    chunk_rows(chunk_rows) {
+}
+
+void Lineage::rename(const std::string &path) {
+  this->path = path;
+  birth_table.rename(path + ".births");
+  death_table.rename(path + ".deaths");
+}
+
+uint64_t Lineage::birth(uint64_t parent, uint64_t frame, int mutations) {
+  uint16_t m = (uint16_t)std::min(mutations, 0xffff);
+  uint64_t alive = 0;
+  const void *values[] = { &parent, &frame, &m, &alive };
+  birth_table.append(values);
+  return birth_table.rows();
+}
+
+void Lineage::death(uint64_t id, uint64_t frame, int age, int score, DeathCause cause) {
+  uint32_t a = age, s = score;
+  uint8_t c = cause;
+  const void *values[] = { &id, &frame, &a, &s, &c };
+  death_table.append(values);
+  uint64_t row = death_table.rows();
+  birth_table.set(id - 1, BIRTH_DEATH, &row);
+}
+
+Birth Lineage::birth_of(uint64_t id) {
+  assert(id >= 1 && id <= births());
+  Birth birth;
+  uint16_t mutations;
+  birth.id = id;
+  birth_table.get(id - 1, BIRTH_PARENT, &birth.parent);
+  birth_table.get(id - 1, BIRTH_FRAME, &birth.frame);
+  birth_table.get(id - 1, BIRTH_MUTATIONS, &mutations);
+  birth.mutations = mutations;
+  return birth;
+}
+
+bool Lineage::death_of(uint64_t id, Death &death) {
+  uint64_t row;
+  birth_table.get(id - 1, BIRTH_DEATH, &row);
+  if (row == 0) {
+    return false;
+  }
+  uint32_t age, score;
+  uint8_t cause;
+  death.id = id;
+  death_table.get(row - 1, DEATH_FRAME, &death.frame);
+  death_table.get(row - 1, DEATH_AGE, &age);
+  death_table.get(row - 1, DEATH_SCORE, &score);
+  death_table.get(row - 1, DEATH_CAUSE, &cause);
+  death.age = age;
+  death.score = score;
+  death.cause = (DeathCause)cause;
+  return true;
+}
+
+void Lineage::ancestors(uint64_t id, std::vector<uint64_t> &out) {
+  out.clear();
+  uint64_t parent;
+  birth_table.get(id - 1, BIRTH_PARENT, &parent);
+  while (parent != 0) {
+    out.push_back(parent);
+    birth_table.get(parent - 1, BIRTH_PARENT, &parent);
+  }
+}
+
+void Lineage::descendants(uint64_t id, std::vector<uint64_t> &out) {
+  out.clear();
+  uint64_t n = births();
+  std::vector<bool> in_tree(n - id + 1, false);
+  in_tree[0] = true;
+  uint64_t parents[SCAN_ROWS];
+  for (uint64_t row = id; row < n; row += SCAN_ROWS) {
+    uint64_t count = std::min<uint64_t>(SCAN_ROWS, n - row);
+    birth_table.get_range(row, count, BIRTH_PARENT, parents);
+    for (uint64_t i = 0; i < count; i++) {
+      uint64_t child = row + i + 1;
+      if (parents[i] >= id && in_tree[parents[i] - id]) {
+        in_tree[child - id] = true;
+        out.push_back(child);
+      }
+    }
+  }
+}
+
+void Lineage::flush() {
+  birth_table.flush();
+  death_table.flush();
+  FILE *meta = fopen((path + ".meta").c_str(), "w");
+  if (!meta) {
+    printf("lineage: could not write %s.meta\n", path.c_str());
+    return;
+  }
+  fprintf(meta, "chunk_rows=%d\n", chunk_rows);
+  fprintf(meta, "births=%llu\n", (unsigned long long)births());
+  fprintf(meta, "deaths=%llu\n", (unsigned long long)deaths());
+  fprintf(meta, "births_columns=parent:u64,frame:u64,mutations:u16,death:u64\n");
+  fprintf(meta, "deaths_columns=id:u64,frame:u64,age:u32,score:u32,cause:u8\n");
+  fclose(meta);
+}
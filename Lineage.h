@@ -0,0 +1,120 @@
+#ifndef __LINEAGE_H_
+#define __LINEAGE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An append-only table of fixed width columns. Rows are grouped into chunks
+// of chunk_rows, and each chunk is one arena block holding every column's
+// values back to back. Once more than resident_chunks chunks are in memory
+// the oldest is written to <path> at its fixed offset and its block reused,
+// so a value is always one read away whether or not it has spilled.
+class ColumnTable {
+public:
+  ColumnTable(const std::string &path, const std::vector<int> &widths, int chunk_rows, int resident_chunks);
+  ~ColumnTable();
+
+  uint64_t rows() const {
+    return row_count;
+  }
+
+  // appends a row; values holds one pointer per column
+  void append(const void *const *values);
+
+  void get(uint64_t row, int column, void *value);
+
+  // overwrites one value of a row already appended, on disk if it spilled
+  void set(uint64_t row, int column, const void *value);
+
+  // copies a run of one column, which may cross chunks, into out
+  void get_range(uint64_t first, uint64_t count, int column, void *out);
+
+  // writes every chunk, including the resident ones, to disk
+  void flush();
+
+  // writes to path instead; only before anything has been written
+  void rename(const std::string &path);
+
+private:
+  std::string path;
+  std::vector<int> widths;
+  std::vector<size_t> column_offsets;
+  size_t chunk_bytes;
+  int chunk_rows;
+  int resident_chunks;
+  uint64_t row_count;
+  std::vector<char *> chunks;  // null once spilled
+  std::vector<char *> free_blocks;
+  size_t first_resident;
+  int fd;
+
+  bool open_file();
+  void spill_oldest();
+};
+
+enum DeathCause {
+  DEATH_STARVATION,
+  DEATH_KILLED,
+  DEATH_CAUSES
+};
+
+struct Birth {
+  uint64_t id;
+  uint64_t parent;  // 0 for agents spawned from nothing
+  uint64_t frame;
+  int mutations;
+};
+
+struct Death {
+  uint64_t id;
+  uint64_t frame;
+  uint32_t age;
+  uint32_t score;
+  DeathCause cause;
+};
+
+// Every birth and death of a run. Agent ids count up from 1 in birth order,
+// so the birth table is indexed by id and a parent always precedes its
+// children: ancestors are a walk up the parent column, descendants one
+// forward scan over it. A death is filled into its birth row as well, so
+// looking one up is a read of each table.
+class Lineage {
+public:
+  enum { CHUNK_ROWS = 1 << 16, RESIDENT_CHUNKS = 64 };
+
+  Lineage(const std::string &path, int chunk_rows = CHUNK_ROWS, int resident_chunks = RESIDENT_CHUNKS);
+
+  // records a birth and returns the new agent's id
+  uint64_t birth(uint64_t parent, uint64_t frame, int mutations);
+  void death(uint64_t id, uint64_t frame, int age, int score, DeathCause cause);
+
+  uint64_t births() const {
+    return birth_table.rows();
+  }
+
+  uint64_t deaths() const {
+    return death_table.rows();
+  }
+
+  Birth birth_of(uint64_t id);
+  bool death_of(uint64_t id, Death &death);
+
+  // parent, grandparent, ... back to an agent spawned from nothing
+  void ancestors(uint64_t id, std::vector<uint64_t> &out);
+  // every agent descended from id, in birth order
+  void descendants(uint64_t id, std::vector<uint64_t> &out);
+
+  void flush();
+
+  // keeps the tables at path instead; only before anything has spilled
+  void rename(const std::string &path);
+
+private:
+  std::string path;
+  ColumnTable birth_table;
+  ColumnTable death_table;
+  int chunk_rows;
+};
+
+#endif
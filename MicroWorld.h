@@ -0,0 +1,268 @@
+#ifndef __MICRO_WORLD_H_
+#define __MICRO_WORLD_H_
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "Brain.h"
+#include "Parameters.h"
+#include "Random.h"
+#include "Senses.h"
+
+// What one agent of a micro-world did before it died or the world ended.
+struct MicroOutcome {
+  int meals;
+  int survival;  // frames alive
+};
+
+// A small, isolated world for judging genomes, built from the sim's rules
+// but not a copy of its schedule: a few agents on a hex map of their own,
+// under the sim's parameters, for a fixed number of frames. The first copies
+// agents carry the genome on trial and the rest its rivals. Agents sense and
+// behave through the sim's tables, wired by the senses given, and eat, move,
+// turn and kill with the sim's costs; they burn health every frame and
+// starve when it runs out, and their memory carries between turns.
+//
+// It differs from the sim in what it leaves out and in its order:
+//
+//   - every agent starts as an adult at full health; there are no eggs, no
+//     incubation and no juvenile period, and the world's parameters for
+//     them are not read
+//   - nothing is born, so spawning does nothing and deaths are not refilled
+//   - a frame runs in three passes: every agent whose turn it is senses the
+//     world as the frame found it, their networks are evaluated, and then
+//     they act in slot order. The sim senses and acts one agent at a time,
+//     so an agent there sees what agents before it did that frame, and here
+//     it does not
+//
+// The networks are evaluated one agent at a time, not as a batch: each runs
+// its genome's own forward(), the kernel the sim thinks with at the genome's
+// precision. Food grows at the sim's rate per hex. Everything is drawn from
+// the world's own generator, so a seed gives the same run on any thread.
+class MicroWorld {
+public:
+  struct Settings {
+    int q, r;    // hexes across
+    int agents;
+    int copies;  // agents carrying the genome on trial
+    int frames;
+    Parameters parameters;
+    Senses senses;
+  };
+
+  MicroWorld(const Settings &settings) : settings(settings) {
+    int hexes = settings.q * settings.r;
+    food.assign(hexes, 0);
+    occupant.assign(hexes, -1);
+    slots.resize(settings.agents);
+    thoughts.resize(settings.agents);
+    ready.reserve(settings.agents);
+  }
+
+  // Runs a world with genomes[0] on trial and genomes[1 ..] as its rivals,
+  // given one per rival slot with the hue each shows other agents' sensors,
+  // and adds the outcome of every copy to out.
+  template <typename Tanh>
+  void run(const AgentGenome *const *genomes, const float *hues, Random &rng, std::vector<MicroOutcome> &out) {
+    const Parameters &p = settings.parameters;
+    int hexes = settings.q * settings.r;
+    // the sim grows food on one hex of its 400 at food_spawn_rate per frame
+    float food_rate = p.food_spawn_rate * hexes / 400.0f;
+    std::fill(food.begin(), food.end(), 0);
+    std::fill(occupant.begin(), occupant.end(), -1);
+    for (int a = 0; a < settings.agents; a++) {
+      Slot &slot = slots[a];
+      int g = a < settings.copies ? 0 : a - settings.copies + 1;
+      slot.genome = genomes[g];
+      slot.hue = hues[g];
+      slot.genome->gains(slot.gains);
+      int hex;
+      do {
+        hex = (int)(rng.uniform() * hexes);
+      } while (occupant[hex] >= 0);
+      occupant[hex] = a;
+      slot.q = hex % settings.q;
+      slot.r = hex / settings.q;
+      slot.orientation = (int)(rng.uniform() * 6.0f);
+      slot.health = p.max_hp;
+      slot.next_action = 0;
+      slot.meals = 0;
+      slot.died = -1;
+      memset(slot.memory, 0, sizeof(slot.memory));
+    }
+    steps = 0;
+
+    for (int frame = 0; frame < settings.frames; frame++) {
+      if (rng.uniform() < food_rate) {
+        food[(int)(rng.uniform() * hexes)] = 1;
+      }
+
+      ready.clear();
+      for (int a = 0; a < settings.agents; a++) {
+        Slot &slot = slots[a];
+        if (slot.died >= 0) {
+          continue;
+        }
+        slot.health -= p.burn_rate;
+        if (slot.health <= 0.0f) {
+          die(a, frame);
+          continue;
+        }
+        steps++;
+        if (frame >= slot.next_action) {
+          sense(slot, thoughts[a].inputs);
+          ready.push_back(a);
+        }
+      }
+
+      // scalar, one forward() per ready agent
+      float hidden[HIDDEN_SIZE];
+      for (size_t i = 0; i < ready.size(); i++) {
+        Thought &thought = thoughts[ready[i]];
+        slots[ready[i]].genome->template forward<Tanh>(thought.inputs, hidden, thought.outputs);
+      }
+
+      for (size_t i = 0; i < ready.size(); i++) {
+        int a = ready[i];
+        if (slots[a].died < 0) {
+          act(a, thoughts[a].outputs, frame);
+        }
+      }
+    }
+
+    for (int a = 0; a < settings.copies; a++) {
+      const Slot &slot = slots[a];
+      MicroOutcome outcome = { slot.meals, slot.died >= 0 ? slot.died : settings.frames };
+      out.push_back(outcome);
+    }
+  }
+
+  // agent-frames lived in the last run
+  long agent_steps() const {
+    return steps;
+  }
+
+private:
+  struct Slot {
+    const AgentGenome *genome;
+    float hue;
+    float gains[Brain::OUTPUTS];
+    int q, r, orientation;
+    float health;
+    int next_action;
+    int meals;
+    int died;  // the frame it died in, or -1
+    float memory[MEMORY_SIZE];
+  };
+
+  struct Thought {
+    float inputs[Brain::INPUTS];
+    float outputs[Brain::OUTPUTS];
+  };
+
+  Settings settings;
+  std::vector<char> food;
+  std::vector<int> occupant;
+  std::vector<Slot> slots;
+  std::vector<Thought> thoughts;
+  std::vector<int> ready;  // agents whose turn it is this frame
+  long steps;
+
+  // the hex at q, r, or -1 off the map
+  int hex_at(int q, int r) const {
+    if (q < 0 || q >= settings.q || r < 0 || r >= settings.r) {
+      return -1;
+    }
+    return q + r * settings.q;
+  }
+
+  // the hex an agent faces, or -1; the directions are the sim's
+  int ahead(const Slot &slot) const {
+    static const int dq[6] = { 1, 0, -1, -1, 0, 1 };
+    static const int dr[6] = { 0, 1, 1, 0, -1, -1 };
+    return hex_at(slot.q + dq[slot.orientation], slot.r + dr[slot.orientation]);
+  }
+
+  // the sensors, as the sim reads them, then memory
+  void sense(const Slot &slot, float (&in)[Brain::INPUTS]) const {
+    for (int s = 0; s < SENSOR_COUNT; s++) {
+      const SensorEntry &sensor = settings.senses.sensors[s];
+      int hex = hex_at(slot.q + sensor.dq[slot.orientation], slot.r + sensor.dr[slot.orientation]);
+      switch (sensor.kind) {
+      case SENSE_FOOD:
+        in[s] = hex >= 0 && food[hex] ? 1.0f : 0.0f;
+        break;
+      case SENSE_AGENT:
+        in[s] = hex >= 0 && occupant[hex] >= 0 ? slots[occupant[hex]].hue : 0.0f;
+        break;
+      default:
+        in[s] = slot.health / settings.parameters.max_hp;
+        break;
+      }
+    }
+    for (int m = 0; m < MEMORY_SIZE; m++) {
+      in[SENSOR_COUNT + m] = slot.memory[m];
+    }
+  }
+
+  void die(int a, int frame) {
+    Slot &slot = slots[a];
+    slot.died = frame;
+    occupant[slot.q + slot.r * settings.q] = -1;
+  }
+
+  // the behaviors in output order, as the sim runs them
+  void act(int a, const float (&out)[Brain::OUTPUTS], int frame) {
+    const Parameters &p = settings.parameters;
+    Slot &slot = slots[a];
+    int waiting = 0;
+    for (int b = 0; b < BEHAVIOR_COUNT; b++) {
+      int here = slot.q + slot.r * settings.q;
+      switch (settings.senses.behaviors[b]) {
+      case BEHAVE_EAT:
+        if (out[b] > slot.gains[b] && food[here]) {
+          food[here] = 0;
+          slot.health = std::min(p.max_hp, slot.health + p.food_value);
+          slot.meals++;
+          waiting += p.eating_waiting;
+        }
+        break;
+      case BEHAVE_MOVE:
+        if (out[b] > slot.gains[b]) {
+          int hex = ahead(slot);
+          if (hex >= 0 && occupant[hex] < 0) {
+            occupant[here] = -1;
+            occupant[hex] = a;
+            slot.q = hex % settings.q;
+            slot.r = hex / settings.q;
+            waiting += p.linear_waiting;
+          }
+        }
+        break;
+      case BEHAVE_KILL:
+        if (out[b] > slot.gains[b]) {
+          int hex = ahead(slot);
+          if (hex >= 0 && occupant[hex] >= 0) {
+            die(occupant[hex], frame);
+            waiting += p.kill_waiting;
+          }
+        }
+        break;
+      case BEHAVE_TURN: {
+        float rotation = out[b] * slot.gains[b];
+        if (rotation < -0.5f || rotation > 0.5f) {
+          slot.orientation = (slot.orientation + (rotation < 0.0f ? +1 : -1) + 6) % 6;
+          waiting += p.rotational_waiting;
+        }
+        break;
+      }
+      }
+    }
+    for (int m = 0; m < MEMORY_SIZE; m++) {
+      slot.memory[m] = out[BEHAVIOR_COUNT + m] * slot.gains[BEHAVIOR_COUNT + m];
+    }
+    slot.next_action = frame + waiting + 1;
+  }
+};
+
+#endif
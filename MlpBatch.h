@@ -0,0 +1,237 @@
+#ifndef __MLP_BATCH_H_
+#define __MLP_BATCH_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <vector>
+#include "Activation.h"
+#include "Random.h"
+
+// One INPUTS-HIDDEN-HIDDEN-OUTPUTS perceptron per agent, all of them stored
+// together with the agent as the innermost dimension, so every kernel below
+// runs across the whole batch a vector at a time.
+//
+// The networks behave like FANN standard networks with symmetric sigmoid
+// activations at the default steepness of 0.5, trained incrementally with
+// the tanh error function: every layer has a bias neuron, outputs are
+// tanh(0.5 * sum), and training does one backpropagation step per call.
+// Tanh is one of the activations in Activation.h.
+template <int INPUTS, int HIDDEN, int OUTPUTS, typename Tanh = TanhRational>
+class MlpBatch {
+public:
+  enum {
+    W1 = HIDDEN * (INPUTS + 1),
+    W2 = HIDDEN * (HIDDEN + 1),
+    W3 = OUTPUTS * (HIDDEN + 1),
+    WEIGHTS = W1 + W2 + W3
+  };
+
+  explicit MlpBatch(int count) : count(count), stride((count + 7) / 8 * 8) {
+    weights.assign((size_t)WEIGHTS * stride, 0.0f);
+    inputs.assign((size_t)INPUTS * stride, 0.0f);
+    hidden1.assign((size_t)HIDDEN * stride, 0.0f);
+    hidden2.assign((size_t)HIDDEN * stride, 0.0f);
+    outputs.assign((size_t)OUTPUTS * stride, 0.0f);
+    errors1.assign((size_t)HIDDEN * stride, 0.0f);
+    errors2.assign((size_t)HIDDEN * stride, 0.0f);
+    errors3.assign((size_t)OUTPUTS * stride, 0.0f);
+    rates.assign(stride, 0.0f);
+  }
+
+  int size() const {
+    return count;
+  }
+
+  // input i of every agent, filled in before run()
+  float *input(int i) {
+    return &inputs[(size_t)i * stride];
+  }
+
+  // output i of every agent, as of the last run()
+  const float *output(int i) const {
+    return &outputs[(size_t)i * stride];
+  }
+
+  void randomize(int agent, Random &rng, float lo, float hi) {
+    for (int w = 0; w < WEIGHTS; w++) {
+      weights[(size_t)w * stride + agent] = lo + (hi - lo) * rng.uniform();
+    }
+  }
+
+  // Every agent's network on its own inputs. The batch kernels here can be
+  // given a range of agents instead, so that threads can split them up:
+  // ranges must start on a multiple of 8 and not overlap.
+  void run(int begin = 0, int end = -1) {
+    end = padded(begin, end);
+    forward(begin, end);
+  }
+
+  // one agent's network on the given inputs, leaving the batch alone
+  void run_one(int agent, const float *in, float *out) const {
+    float h1[HIDDEN], h2[HIDDEN];
+    layer_one(w1() + agent, INPUTS, HIDDEN, in, h1);
+    layer_one(w2() + agent, HIDDEN, HIDDEN, h1, h2);
+    layer_one(w3() + agent, HIDDEN, OUTPUTS, h2, out);
+  }
+
+  // One step of backpropagation on every agent towards the same example,
+  // each at its own learning rate; a rate of 0 leaves an agent untouched.
+  // Overwrites the inputs and outputs of the last run().
+  void train(const float *in, const float *desired, const float *learning_rates, int begin = 0, int end = -1) {
+    end = padded(begin, end);
+    for (int i = 0; i < INPUTS; i++) {
+      float *x = input(i);
+      for (int a = begin; a < end; a++) {
+        x[a] = in[i];
+      }
+    }
+    for (int a = begin; a < std::min(end, count); a++) {
+      rates[a] = learning_rates[a];
+    }
+    forward(begin, end);
+
+    // output errors, under the tanh error function on half the difference
+    for (int k = 0; k < OUTPUTS; k++) {
+      const float *y = &outputs[(size_t)k * stride];
+      float *e = &errors3[(size_t)k * stride];
+      for (int a = begin; a < end; a++) {
+        float diff = (desired[k] - y[a]) * 0.5f;
+        diff = diff > 0.9999999f ? 0.9999999f : diff < -0.9999999f ? -0.9999999f : diff;
+        float error = Random::log_approx((1.0f + diff) / (1.0f - diff));
+        error = diff >= 0.9999999f ? 17.0f : diff <= -0.9999999f ? -17.0f : error;
+        e[a] = error * derivative(y[a]);
+      }
+    }
+    back(w3(), HIDDEN, OUTPUTS, errors3.data(), hidden2.data(), errors2.data(), begin, end);
+    back(w2(), HIDDEN, HIDDEN, errors2.data(), hidden1.data(), errors1.data(), begin, end);
+
+    update(w1(), INPUTS, HIDDEN, inputs.data(), errors1.data(), begin, end);
+    update(w2(), HIDDEN, HIDDEN, hidden1.data(), errors2.data(), begin, end);
+    update(w3(), HIDDEN, OUTPUTS, hidden2.data(), errors3.data(), begin, end);
+  }
+
+  void print(int agent) const {
+    const float *layers[] = { w1(), w2(), w3() };
+    const int ins[] = { INPUTS, HIDDEN, HIDDEN };
+    const int outs[] = { HIDDEN, HIDDEN, OUTPUTS };
+    for (int l = 0; l < 3; l++) {
+      for (int o = 0; o < outs[l]; o++) {
+        for (int i = 0; i <= ins[l]; i++) {
+          printf("layer %d: %d -> %d: %f\n", l, i, o, layers[l][(size_t)(o * (ins[l] + 1) + i) * stride + agent]);
+        }
+      }
+    }
+  }
+
+private:
+  int count;
+  int stride;
+  // weight w of agent a at w * stride + a; each layer's weights run by
+  // output neuron, then by input with the bias last
+  std::vector<float> weights;
+  std::vector<float> inputs, hidden1, hidden2, outputs;
+  std::vector<float> errors1, errors2, errors3;
+  std::vector<float> rates;
+
+  float *w1() { return &weights[0]; }
+  float *w2() { return &weights[(size_t)W1 * stride]; }
+  float *w3() { return &weights[(size_t)(W1 + W2) * stride]; }
+  const float *w1() const { return &weights[0]; }
+  const float *w2() const { return &weights[(size_t)W1 * stride]; }
+  const float *w3() const { return &weights[(size_t)(W1 + W2) * stride]; }
+
+  // FANN clips the value so saturated neurons keep learning
+  static inline float derivative(float y) {
+    y = y > 0.98f ? 0.98f : y < -0.98f ? -0.98f : y;
+    return 0.5f * (1.0f - y * y);
+  }
+
+  // the end of a range of agents, out to the padding after the last agent
+  int padded(int begin, int end) const {
+    assert(begin % 8 == 0);
+    return end < 0 || end >= count ? stride : end;
+  }
+
+  void forward(int begin, int end) {
+    layer(w1(), INPUTS, HIDDEN, inputs.data(), hidden1.data(), begin, end);
+    layer(w2(), HIDDEN, HIDDEN, hidden1.data(), hidden2.data(), begin, end);
+    layer(w3(), HIDDEN, OUTPUTS, hidden2.data(), outputs.data(), begin, end);
+  }
+
+  void layer(const float *w, int in_count, int out_count, const float *in, float *out, int begin, int end) const {
+    for (int o = 0; o < out_count; o++) {
+      const float *row = w + (size_t)o * (in_count + 1) * stride;
+      const float *bias = row + (size_t)in_count * stride;
+      float *y = out + (size_t)o * stride;
+      for (int a = begin; a < end; a++) {
+        y[a] = bias[a];
+      }
+      for (int i = 0; i < in_count; i++) {
+        const float *wi = row + (size_t)i * stride;
+        const float *x = in + (size_t)i * stride;
+        for (int a = begin; a < end; a++) {
+          y[a] += wi[a] * x[a];
+        }
+      }
+      Tanh activate;
+      for (int a = begin; a < end; a++) {
+        y[a] = activate(0.5f * y[a]);
+      }
+    }
+  }
+
+  // the same layer for one agent, w already offset to it
+  void layer_one(const float *w, int in_count, int out_count, const float *in, float *out) const {
+    Tanh activate;
+    for (int o = 0; o < out_count; o++) {
+      const float *row = w + (size_t)o * (in_count + 1) * stride;
+      float sum = row[(size_t)in_count * stride];
+      for (int i = 0; i < in_count; i++) {
+        sum += row[(size_t)i * stride] * in[i];
+      }
+      out[o] = activate(0.5f * sum);
+    }
+  }
+
+  // errors of a layer's inputs from the errors of its outputs
+  void back(const float *w, int in_count, int out_count, const float *out_errors, const float *in, float *in_errors, int begin, int end) {
+    for (int i = 0; i < in_count; i++) {
+      float *e = in_errors + (size_t)i * stride;
+      for (int a = begin; a < end; a++) {
+        e[a] = 0.0f;
+      }
+      for (int o = 0; o < out_count; o++) {
+        const float *wi = w + (size_t)(o * (in_count + 1) + i) * stride;
+        const float *eo = out_errors + (size_t)o * stride;
+        for (int a = begin; a < end; a++) {
+          e[a] += eo[a] * wi[a];
+        }
+      }
+      const float *y = in + (size_t)i * stride;
+      for (int a = begin; a < end; a++) {
+        e[a] *= derivative(y[a]);
+      }
+    }
+  }
+
+  void update(float *w, int in_count, int out_count, const float *in, const float *out_errors, int begin, int end) {
+    for (int o = 0; o < out_count; o++) {
+      float *row = w + (size_t)o * (in_count + 1) * stride;
+      const float *eo = out_errors + (size_t)o * stride;
+      for (int i = 0; i < in_count; i++) {
+        float *wi = row + (size_t)i * stride;
+        const float *x = in + (size_t)i * stride;
+        for (int a = begin; a < end; a++) {
+          wi[a] += rates[a] * eo[a] * x[a];
+        }
+      }
+      float *bias = row + (size_t)in_count * stride;
+      for (int a = begin; a < end; a++) {
+        bias[a] += rates[a] * eo[a];
+      }
+    }
+  }
+};
+
+#endif
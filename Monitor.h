@@ -0,0 +1,164 @@
+#ifndef __MONITOR_H_
+#define __MONITOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Parameters.h"
+#include "Stats.h"
+
+// Live state of a running sim, published to a POSIX shared memory segment
+// named /patterns-<pid> for external monitors. The sim only ever writes
+// memory it has mapped, so publishing costs no syscalls; readers attach and
+// copy it out under a seqlock.
+
+enum Phase {
+  PHASE_WORLD,     // config, spawning and food
+  PHASE_AGENTS,    // the agents due this frame
+  PHASE_RECORD,    // stats, species and records
+  PHASE_DISPLAY,
+  PHASES
+};
+
+const char *const PHASE_NAMES[PHASES] = { "world", "agents", "record", "display" };
+
+struct MonitorData {
+  int frame;
+  int species;
+  int distinct_genomes;
+  int island;
+  int islands;
+  uint64_t emigrants;   // genomes sent to other islands
+  uint64_t immigrants;  // and received from them
+  uint64_t phase_ns[PHASES];  // totals since the start of the run
+  StatsSnapshot stats;
+  Parameters parameters;
+};
+
+struct MonitorSegment {
+  enum { MAGIC = 0x504f4c31 };  // POL1
+
+  uint32_t magic;
+  uint32_t size;
+  std::atomic<uint32_t> sequence;  // odd while a write is under way
+  MonitorData data;
+};
+
+inline std::string monitor_name(int pid) {
+  return "/patterns-" + std::to_string(pid);
+}
+
+class MonitorWriter {
+public:
+  MonitorWriter() : segment(0) {
+  }
+
+  ~MonitorWriter() {
+    close();
+  }
+
+  bool open(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      printf("monitor: could not open %s\n", name.c_str());
+      return false;
+    }
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, sizeof(MonitorSegment)) == 0) {
+      memory = mmap(0, sizeof(MonitorSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+      printf("monitor: could not map %s\n", name.c_str());
+      shm_unlink(name.c_str());
+      return false;
+    }
+    this->name = name;
+    segment = (MonitorSegment *)memory;
+    segment->size = sizeof(MonitorSegment);
+    segment->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = MonitorSegment::MAGIC;
+    return true;
+  }
+
+  void close() {
+    if (segment) {
+      munmap(segment, sizeof(MonitorSegment));
+      shm_unlink(name.c_str());
+      segment = 0;
+    }
+  }
+
+  void publish(const MonitorData &data) {
+    if (!segment) {
+      return;
+    }
+    uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+    segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&segment->data, &data, sizeof(data));
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+private:
+  std::string name;
+  MonitorSegment *segment;
+};
+
+class MonitorReader {
+public:
+  MonitorReader() : segment(0) {
+  }
+
+  ~MonitorReader() {
+    if (segment) {
+      munmap(segment, sizeof(MonitorSegment));
+    }
+  }
+
+  bool attach(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      return false;
+    }
+    void *memory = mmap(0, sizeof(MonitorSegment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+      return false;
+    }
+    segment = (MonitorSegment *)memory;
+    if (segment->magic != MonitorSegment::MAGIC || segment->size != sizeof(MonitorSegment)) {
+      munmap(segment, sizeof(MonitorSegment));
+      segment = 0;
+      return false;
+    }
+    return true;
+  }
+
+  // a consistent copy of the latest data; false if the writer never let go
+  bool read(MonitorData &data) const {
+    for (int attempt = 0; attempt < 1000; attempt++) {
+      uint32_t before = segment->sequence.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;
+      }
+      memcpy(&data, (const void *)&segment->data, sizeof(data));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (segment->sequence.load(std::memory_order_relaxed) == before) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  MonitorSegment *segment;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef __NETWORK_H_
+#define __NETWORK_H_
+
+#include <cmath>
+#include "Activation.h"
+
+// calls f(0), f(1) .. f(N - 1) with the loop fully unrolled at compile time
+template <int N>
+struct Unroll {
+  template <typename F>
+  static inline void apply(F &&f) {
+    Unroll<N - 1>::apply(f);
+    f(N - 1);
+  }
+};
+
+template <>
+struct Unroll<0> {
+  template <typename F>
+  static inline void apply(F &&) {}
+};
+
+template <int N>
+inline float dot(const float *a, const float *b) {
+  float sum = 0.0f;
+  Unroll<N>::apply([&](int i) { sum += a[i] * b[i]; });
+  return sum;
+}
+
+// A two layer perceptron with recurrent memory. SENSORS + MEMORY inputs feed
+// HIDDEN tanh nodes, which feed BEHAVIORS + MEMORY tanh outputs. Every output
+// has a gain, used as a threshold by behaviors and as a scale by memory.
+//
+// The genome is laid out flat:
+//
+//   [ hidden weights | output weights | gains ]
+//
+template <int SENSORS, int HIDDEN, int BEHAVIORS, int MEMORY>
+struct Network {
+  enum {
+    INPUTS = SENSORS + MEMORY,
+    HIDDEN_SIZE = HIDDEN,
+    OUTPUTS = BEHAVIORS + MEMORY,
+
+    HIDDEN_WEIGHTS_OFFSET = 0,
+    HIDDEN_WEIGHTS_SIZE = INPUTS * HIDDEN,
+    OUTPUT_WEIGHTS_OFFSET = HIDDEN_WEIGHTS_OFFSET + HIDDEN_WEIGHTS_SIZE,
+    OUTPUT_WEIGHTS_SIZE = HIDDEN * OUTPUTS,
+    GAINS_OFFSET = OUTPUT_WEIGHTS_OFFSET + OUTPUT_WEIGHTS_SIZE,
+    GAINS_SIZE = OUTPUTS,
+
+    DNA_SIZE = GAINS_OFFSET + GAINS_SIZE,
+
+    BLOCKS = 3
+  };
+
+  static_assert(SENSORS > 0 && HIDDEN > 0 && BEHAVIORS > 0 && MEMORY >= 0, "bad network shape");
+  static_assert(DNA_SIZE == INPUTS * HIDDEN + HIDDEN * OUTPUTS + OUTPUTS, "bad genome layout");
+
+  typedef float HiddenWeights[HIDDEN][INPUTS];
+  typedef float OutputWeights[OUTPUTS][HIDDEN];
+  typedef float Gains[OUTPUTS];
+
+  // which block (hidden weights, output weights, gains) a gene belongs to
+  static inline int block_of(int gene) {
+    return gene < OUTPUT_WEIGHTS_OFFSET ? 0 : gene < GAINS_OFFSET ? 1 : 2;
+  }
+
+  static inline int block_offset(int block) {
+    return block == 0 ? HIDDEN_WEIGHTS_OFFSET : block == 1 ? OUTPUT_WEIGHTS_OFFSET : GAINS_OFFSET;
+  }
+
+  static inline int block_size(int block) {
+    return block == 0 ? HIDDEN_WEIGHTS_SIZE : block == 1 ? OUTPUT_WEIGHTS_SIZE : GAINS_SIZE;
+  }
+
+  // typed views of each block of a genome
+
+  static const HiddenWeights &hidden_weights(const float *dna) {
+    return *reinterpret_cast<const HiddenWeights *>(dna + HIDDEN_WEIGHTS_OFFSET);
+  }
+
+  static const OutputWeights &output_weights(const float *dna) {
+    return *reinterpret_cast<const OutputWeights *>(dna + OUTPUT_WEIGHTS_OFFSET);
+  }
+
+  static const Gains &gains(const float *dna) {
+    return *reinterpret_cast<const Gains *>(dna + GAINS_OFFSET);
+  }
+
+  static HiddenWeights &hidden_weights(float *dna) {
+    return *reinterpret_cast<HiddenWeights *>(dna + HIDDEN_WEIGHTS_OFFSET);
+  }
+
+  static OutputWeights &output_weights(float *dna) {
+    return *reinterpret_cast<OutputWeights *>(dna + OUTPUT_WEIGHTS_OFFSET);
+  }
+
+  static Gains &gains(float *dna) {
+    return *reinterpret_cast<Gains *>(dna + GAINS_OFFSET);
+  }
+
+  // evaluate the network; hidden activations are returned for inspection
+  template <typename Tanh = TanhExact>
+  static inline void forward(const float *dna,
+                             const float (&inputs)[INPUTS],
+                             float (&hidden)[HIDDEN],
+                             float (&outputs)[OUTPUTS]) {
+    Tanh activate;
+    const HiddenWeights &hw = hidden_weights(dna);
+    Unroll<HIDDEN>::apply([&](int j) {
+      hidden[j] = activate(dot<INPUTS>(inputs, hw[j]));
+    });
+    const OutputWeights &ow = output_weights(dna);
+    Unroll<OUTPUTS>::apply([&](int k) {
+      outputs[k] = activate(dot<HIDDEN>(hidden, ow[k]));
+    });
+  }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __PARAMETERS_H_
+#define __PARAMETERS_H_
+
+#include "Activation.h"
+
+// The config values a run's trajectory depends on, as plain data so that
+// they can be published and journaled as they are.
+struct Parameters {
+  int num_agents;
+  float agent_spawn_rate;
+  float food_spawn_rate;
+  float food_value;
+  float max_hp;
+  int rotational_waiting;
+  int linear_waiting;
+  int eating_waiting;
+  int kill_waiting;
+  int spawning_waiting;
+  int incubation_period;
+  int juvenile_period;
+  float burn_rate;
+  float mutate_rate;
+  float mutate_amount;
+  float dna_multiplier;
+  float species_threshold;
+  int species_cosine;
+  int activation;
+};
+
+// The values the config file ships with. The sim starts from them, so a
+// key left out of config keeps its default, and tools that run agents away
+// from the sim, like evaluate, take them as they are.
+inline Parameters default_parameters() {
+  Parameters p;
+  p.num_agents = 100;
+  p.agent_spawn_rate = 0.01f;
+  p.food_spawn_rate = 0.1f;
+  p.food_value = 100.0f;
+  p.max_hp = 100.0f;
+  p.rotational_waiting = 1;
+  p.linear_waiting = 10;
+  p.eating_waiting = 10;
+  p.kill_waiting = 10;
+  p.spawning_waiting = 50;
+  p.incubation_period = 1000;
+  p.juvenile_period = 334;
+  p.burn_rate = 0.3f;
+  p.mutate_rate = 0.1f;
+  p.mutate_amount = 0.01f;
+  p.dna_multiplier = 0.7f;
+  p.species_threshold = 2.0f;
+  p.species_cosine = 0;
+  p.activation = ACTIVATION_EXACT;
+  return p;
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef __RANDOM_H_
+#define __RANDOM_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+
+// Bulk random numbers. Eight interleaved xoshiro128+ generators advance in
+// lock step, so the fill loops below compile to vector code, and normals come
+// from Box-Muller with branch free log and sincos approximations. Single
+// draws are served from buffers that are refilled in bulk.
+class Random {
+public:
+  enum { LANES = 8, BUFFER_SIZE = 256 };
+
+  explicit Random(uint64_t seed) {
+    this->seed(seed);
+  }
+
+  void seed(uint64_t seed) {
+    for (int lane = 0; lane < LANES; lane++) {
+      for (int w = 0; w < 4; w++) {
+        seed = splitmix64(seed);
+        state[w][lane] = (uint32_t)(seed >> 32);
+      }
+    }
+    uniform_next = BUFFER_SIZE;
+    normal_next = BUFFER_SIZE;
+    skip_rate = -1.0f;
+    skip_log = 0.0f;
+  }
+
+  // n uniforms in [0, 1)
+  void uniforms(float *out, int n) {
+    float block[LANES];
+    for (int i = 0; i < n; i += LANES) {
+      float *dst = n - i >= LANES ? out + i : block;
+      next_block(dst);
+      if (dst == block) {
+        memcpy(out + i, block, (n - i) * sizeof(float));
+      }
+    }
+  }
+
+  // n standard normals
+  void normals(float *out, int n) {
+    float u[LANES], v[LANES], block[2 * LANES];
+    for (int i = 0; i < n; i += 2 * LANES) {
+      next_block(u);
+      next_block(v);
+      float *dst = n - i >= 2 * LANES ? out + i : block;
+      for (int lane = 0; lane < LANES; lane++) {
+        float r = sqrtf(-2.0f * log_approx(1.0f - u[lane]));
+        float s, c;
+        sincos_turns(v[lane], s, c);
+        dst[lane] = r * c;
+        dst[LANES + lane] = r * s;
+      }
+      if (dst == block) {
+        memcpy(out + i, block, (n - i) * sizeof(float));
+      }
+    }
+  }
+
+  float uniform() {
+    if (uniform_next == BUFFER_SIZE) {
+      uniforms(uniform_buffer, BUFFER_SIZE);
+      uniform_next = 0;
+    }
+    return uniform_buffer[uniform_next++];
+  }
+
+  float normal() {
+    if (normal_next == BUFFER_SIZE) {
+      normals(normal_buffer, BUFFER_SIZE);
+      normal_next = 0;
+    }
+    return normal_buffer[normal_next++];
+  }
+
+  // number of trials to skip before the next success, for trials that each
+  // succeed with the given rate; lets a caller visit only the successes
+  int skip(float rate) {
+    if (rate <= 0.0f) {
+      return INT_MAX / 2;
+    }
+    if (rate >= 1.0f) {
+      return 0;
+    }
+    if (rate != skip_rate) {
+      skip_rate = rate;
+      skip_log = 1.0f / log1pf(-rate);
+    }
+    float gap = floorf(log_approx(1.0f - uniform()) * skip_log);
+    return gap < (float)(INT_MAX / 2) ? (int)gap : INT_MAX / 2;
+  }
+
+  // natural log for normal positive x, after Cephes logf
+  static inline float log_approx(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int e = (int)((bits >> 23) & 0xff) - 126;
+    bits = (bits & 0x7fffff) | 0x3f000000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    bool low = m < 0.707106781186547524f;
+    e -= low ? 1 : 0;
+    float f = low ? m + m - 1.0f : m - 1.0f;
+    float z = f * f;
+    float y = 7.0376836292e-2f;
+    y = y * f - 1.1514610310e-1f;
+    y = y * f + 1.1676998740e-1f;
+    y = y * f - 1.2420140846e-1f;
+    y = y * f + 1.4249322787e-1f;
+    y = y * f - 1.6668057665e-1f;
+    y = y * f + 2.0000714765e-1f;
+    y = y * f - 2.4999993993e-1f;
+    y = y * f + 3.3333331174e-1f;
+    y = y * f * z;
+    y += e * -2.12194440e-4f;
+    y += -0.5f * z;
+    return f + y + e * 0.693359375f;
+  }
+
+  // sine and cosine of a whole number of turns t in [0, 1)
+  static inline void sincos_turns(float t, float &s, float &c) {
+    const float pi = 3.14159265358979f;
+    float x = 2.0f * pi * t - pi;
+    float y = x + 0.5f * pi;
+    y = y > pi ? y - 2.0f * pi : y;
+    s = -sin_reduced(x > 0.5f * pi ? pi - x : x < -0.5f * pi ? -pi - x : x);
+    c = -sin_reduced(y > 0.5f * pi ? pi - y : y < -0.5f * pi ? -pi - y : y);
+  }
+
+private:
+  uint32_t state[4][LANES];
+  float uniform_buffer[BUFFER_SIZE];
+  float normal_buffer[BUFFER_SIZE];
+  int uniform_next;
+  int normal_next;
+  float skip_rate;
+  float skip_log;
+
+  static uint64_t splitmix64(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // sin on [-pi/2, pi/2]
+  static inline float sin_reduced(float x) {
+    float z = x * x;
+    float y = -2.50521083854e-8f;
+    y = y * z + 2.75573192240e-6f;
+    y = y * z - 1.98412698413e-4f;
+    y = y * z + 8.33333333333e-3f;
+    y = y * z - 1.66666666667e-1f;
+    return x + x * z * y;
+  }
+
+  // one xoshiro128+ step on every lane, top 24 bits to floats in [0, 1)
+  inline void next_block(float *out) {
+    uint32_t *s0 = state[0], *s1 = state[1], *s2 = state[2], *s3 = state[3];
+    for (int lane = 0; lane < LANES; lane++) {
+      uint32_t result = s0[lane] + s3[lane];
+      uint32_t t = s1[lane] << 9;
+      s2[lane] ^= s0[lane];
+      s3[lane] ^= s1[lane];
+      s1[lane] ^= s2[lane];
+      s0[lane] ^= s3[lane];
+      s2[lane] ^= t;
+      s3[lane] = (s3[lane] << 11) | (s3[lane] >> 21);
+      out[lane] = (float)(result >> 8) * (1.0f / 16777216.0f);
+    }
+  }
+};
+
+#endif
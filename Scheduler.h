@@ -0,0 +1,72 @@
+#ifndef __SCHEDULER_H_
+#define __SCHEDULER_H_
+
+#include <vector>
+#include <algorithm>
+
+// A timing wheel of agents keyed on the frame they next need attention.
+// SLOTS buckets cover the next SLOTS frames; an entry further out sits in
+// its bucket and is passed over until its own lap comes around.
+//
+// Each agent has at most one live entry. Scheduling an agent again, or
+// cancelling it, bumps its ticket, and entries holding an old ticket are
+// dropped when their bucket comes up.
+class Scheduler {
+public:
+  enum { SLOTS = 1024 };
+
+  struct Entry {
+    int agent;
+    int ticket;
+    int frame;
+
+    bool operator<(const Entry &other) const {
+      return agent < other.agent;
+    }
+  };
+
+  void schedule(int agent, int frame) {
+    if (agent >= (int)tickets.size()) {
+      tickets.resize(agent + 1, 0);
+    }
+    Entry entry = { agent, ++tickets[agent], frame };
+    slots[frame % SLOTS].push_back(entry);
+  }
+
+  void cancel(int agent) {
+    if (agent < (int)tickets.size()) {
+      tickets[agent]++;
+    }
+  }
+
+  // whether an entry returned by due() still stands
+  bool is_current(const Entry &entry) const {
+    return tickets[entry.agent] == entry.ticket;
+  }
+
+  // every agent due at frame, in agent order
+  void due(int frame, std::vector<Entry> &out) {
+    out.clear();
+    std::vector<Entry> &slot = slots[frame % SLOTS];
+    size_t kept = 0;
+    for (size_t i = 0; i < slot.size(); i++) {
+      const Entry &entry = slot[i];
+      if (!is_current(entry)) {
+        continue;
+      }
+      if (entry.frame <= frame) {
+        out.push_back(entry);
+      } else {
+        slot[kept++] = entry;
+      }
+    }
+    slot.resize(kept);
+    std::sort(out.begin(), out.end());
+  }
+
+private:
+  std::vector<Entry> slots[SLOTS];
+  std::vector<int> tickets;
+};
+
+#endif
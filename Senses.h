@@ -0,0 +1,102 @@
+#ifndef __SENSES_H_
+#define __SENSES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Brain.h"
+
+// What an agent's network reads and what its outputs do, as flat tables
+// built once from config. Each network input has a sensor entry and each
+// behavior output a behavior kind, run in output order; the step loop
+// switches on the kind, with no virtual calls.
+enum SensorKind {
+  SENSE_FOOD,    // 1 if the hex holds food
+  SENSE_AGENT,   // the hue of the agent on the hex, or 0
+  SENSE_HEALTH,  // the agent's own health over max_hp
+  SENSOR_KINDS
+};
+
+static const char *const SENSOR_KIND_NAMES[SENSOR_KINDS] = { "food", "agent", "health" };
+
+enum BehaviorKind {
+  BEHAVE_EAT,
+  BEHAVE_MOVE,
+  BEHAVE_KILL,
+  BEHAVE_TURN,   // left or right by the sign of its output, past +-0.5
+  BEHAVE_SPAWN,
+  BEHAVIOR_KINDS
+};
+
+static const char *const BEHAVIOR_KIND_NAMES[BEHAVIOR_KINDS] = { "eat", "move", "kill", "turn", "spawn" };
+
+template <int N>
+inline int kind_named(const char *const (&names)[N], const std::string &name) {
+  for (int k = 0; k < N; k++) {
+    if (name == names[k]) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+struct SensorEntry {
+  int kind;
+  // for hex sensors, the hex distance steps from the agent, direction turns
+  // from its facing: the offset sensed for each way the agent can face
+  int dq[6], dr[6];
+};
+
+struct Senses {
+  SensorEntry sensors[SENSOR_COUNT];
+  int behaviors[BEHAVIOR_COUNT];
+
+  // a hash of the whole layout, which genomes evolved under it carry so
+  // they are not run under another
+  uint32_t signature() const {
+    static_assert(sizeof(Senses) == sizeof(int) * (SENSOR_COUNT * 13 + BEHAVIOR_COUNT), "senses are hashed as bytes");
+    uint32_t hash = 2166136261u;  // FNV-1a
+    const unsigned char *bytes = (const unsigned char *)this;
+    for (size_t i = 0; i < sizeof(*this); i++) {
+      hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+  }
+
+  // a sensor looking distance hexes along direction, turned from the facing
+  static SensorEntry sensor(int kind, int direction = 0, int distance = 0) {
+    // the axial steps of the sim's six directions
+    static const int step_q[6] = { 1, 0, -1, -1, 0, 1 };
+    static const int step_r[6] = { 0, 1, 1, 0, -1, -1 };
+    SensorEntry entry;
+    entry.kind = kind;
+    for (int facing = 0; facing < 6; facing++) {
+      int d = ((facing + direction) % 6 + 6) % 6;
+      entry.dq[facing] = step_q[d] * distance;
+      entry.dr[facing] = step_r[d] * distance;
+    }
+    return entry;
+  }
+
+  // the layout the sim has always had: food here, three ahead, two to each
+  // side and health in; eat, move, kill, turn and spawn out
+  static Senses standard() {
+    static_assert(SENSOR_COUNT == 9 && BEHAVIOR_COUNT == 5, "the standard senses do not match the network");
+    Senses senses;
+    senses.sensors[0] = sensor(SENSE_FOOD, 0, 0);
+    senses.sensors[1] = sensor(SENSE_FOOD, 0, 1);
+    senses.sensors[2] = sensor(SENSE_FOOD, 0, 2);
+    senses.sensors[3] = sensor(SENSE_FOOD, 0, 3);
+    senses.sensors[4] = sensor(SENSE_FOOD, 1, 1);
+    senses.sensors[5] = sensor(SENSE_FOOD, 1, 2);
+    senses.sensors[6] = sensor(SENSE_FOOD, -1, 1);
+    senses.sensors[7] = sensor(SENSE_FOOD, -1, 2);
+    senses.sensors[8] = sensor(SENSE_HEALTH);
+    for (int b = 0; b < BEHAVIOR_COUNT; b++) {
+      senses.behaviors[b] = b;
+    }
+    return senses;
+  }
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef __SPECIES_H_
+#define __SPECIES_H_
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include "Brain.h"
+
+//
+// distance kernels
+//
+
+// Vectors are zero padded to a multiple of KERNEL_LANES and every lane keeps
+// its own partial sums, so these loops compile to vector code without asking
+// the compiler to reassociate floats.
+const int KERNEL_LANES = 8;
+
+template <int N>
+inline float l2_squared(const float *a, const float *b) {
+  static_assert(N % KERNEL_LANES == 0, "pad vectors to a multiple of KERNEL_LANES");
+  float sum[KERNEL_LANES] = { };
+  for (int i = 0; i < N; i += KERNEL_LANES) {
+    for (int lane = 0; lane < KERNEL_LANES; lane++) {
+      float d = a[i + lane] - b[i + lane];
+      sum[lane] += d * d;
+    }
+  }
+  float total = 0.0f;
+  for (int lane = 0; lane < KERNEL_LANES; lane++) {
+    total += sum[lane];
+  }
+  return total;
+}
+
+template <int N>
+inline float dot_product(const float *a, const float *b) {
+  static_assert(N % KERNEL_LANES == 0, "pad vectors to a multiple of KERNEL_LANES");
+  float sum[KERNEL_LANES] = { };
+  for (int i = 0; i < N; i += KERNEL_LANES) {
+    for (int lane = 0; lane < KERNEL_LANES; lane++) {
+      sum[lane] += a[i + lane] * b[i + lane];
+    }
+  }
+  float total = 0.0f;
+  for (int lane = 0; lane < KERNEL_LANES; lane++) {
+    total += sum[lane];
+  }
+  return total;
+}
+
+// 1 - cos(a, b), given both norms
+template <int N>
+inline float cosine_distance(const float *a, const float *b, float a_norm, float b_norm) {
+  float norms = a_norm * b_norm;
+  return norms > 0.0f ? 1.0f - dot_product<N>(a, b) / norms : 1.0f;
+}
+
+// Online clustering of the live population's genomes. A genome joins the
+// nearest species within threshold of its centroid, or founds a new one;
+// once every slot is taken it joins the nearest regardless. Members never
+// move, but centroids drift with them: recentering sets each centroid to the
+// mean of its current members. A species is gone once its last member is.
+class Species {
+public:
+  enum {
+    MAX_SPECIES = 32,
+    DIMS = (DNA_SIZE + KERNEL_LANES - 1) / KERNEL_LANES * KERNEL_LANES
+  };
+
+  enum Metric { L2, COSINE };
+
+  Species() : metric(L2), threshold(2.0f), live(0) {
+    memset(sizes, 0, sizeof(sizes));
+    memset(hues, 0, sizeof(hues));
+  }
+
+  // threshold is a plain distance for L2 and 1 - cos for COSINE
+  void configure(Metric metric, float threshold) {
+    this->metric = metric;
+    this->threshold = threshold;
+  }
+
+  // the species of a newborn with these genes; hue colors a new species
+  int join(const float *genes, float hue) {
+    float x[DIMS] = { };
+    memcpy(x, genes, DNA_SIZE * sizeof(float));
+    float norm = sqrtf(dot_product<DIMS>(x, x));
+    int nearest = -1, open = -1;
+    float best = 0.0f;
+    for (int s = 0; s < MAX_SPECIES; s++) {
+      if (sizes[s] == 0) {
+        if (open < 0) {
+          open = s;
+        }
+        continue;
+      }
+      float d = distance(x, norm, s);
+      if (nearest < 0 || d < best) {
+        nearest = s;
+        best = d;
+      }
+    }
+    if (nearest < 0 || (best > threshold && open >= 0)) {
+      memcpy(centroids[open], x, sizeof(x));
+      norms[open] = norm;
+      hues[open] = hue;
+      live++;
+      nearest = open;
+    }
+    sizes[nearest]++;
+    return nearest;
+  }
+
+  void leave(int s) {
+    if (s < 0) {
+      return;
+    }
+    assert(sizes[s] > 0);
+    if (--sizes[s] == 0) {
+      live--;
+    }
+  }
+
+  // pass every member to accumulate() between begin_recenter and end_recenter
+  void begin_recenter() {
+    memset(sums, 0, sizeof(sums));
+    memset(tallies, 0, sizeof(tallies));
+  }
+
+  void accumulate(int s, const float *genes) {
+    float *sum = sums[s];
+    for (int i = 0; i < DNA_SIZE; i++) {
+      sum[i] += genes[i];
+    }
+    tallies[s]++;
+  }
+
+  void end_recenter() {
+    for (int s = 0; s < MAX_SPECIES; s++) {
+      if (tallies[s] == 0) {
+        continue;
+      }
+      float inverse = 1.0f / tallies[s];
+      for (int i = 0; i < DIMS; i++) {
+        centroids[s][i] = sums[s][i] * inverse;
+      }
+      norms[s] = sqrtf(dot_product<DIMS>(centroids[s], centroids[s]));
+    }
+  }
+
+  int count() const {
+    return live;
+  }
+
+  int size(int s) const {
+    return sizes[s];
+  }
+
+  float hue(int s) const {
+    return hues[s];
+  }
+
+private:
+  Metric metric;
+  float threshold;
+  int live;
+  float centroids[MAX_SPECIES][DIMS];
+  float sums[MAX_SPECIES][DIMS];
+  float norms[MAX_SPECIES];
+  float hues[MAX_SPECIES];
+  int sizes[MAX_SPECIES];
+  int tallies[MAX_SPECIES];
+
+  float distance(const float *x, float norm, int s) const {
+    if (metric == COSINE) {
+      return cosine_distance<DIMS>(x, centroids[s], norm, norms[s]);
+    }
+    return sqrtf(l2_squared<DIMS>(x, centroids[s]));
+  }
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef __STATS_H_
+#define __STATS_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Lineage.h"
+
+// What the population looks like at one frame. Counters are totals since the
+// start of the run.
+struct StatsSnapshot {
+  int frame;
+  uint64_t births;
+  uint64_t deaths[DEATH_CAUSES];
+  uint64_t kills;
+  uint64_t meals;
+  uint64_t moves_attempted;
+  uint64_t moves;
+  uint64_t spawns_attempted;
+  uint64_t spawns;
+  int live;
+  float mean_age;
+  int max_age;
+  float mean_score;
+  int max_score;
+};
+
+// Population statistics kept up to date by the events that change them, so
+// reading any of them costs the same however often it is done.
+//
+// Means come from running sums, and the best score is found from a count of
+// agents at each score. The oldest agent is the top of a min-heap by birth
+// frame, each entry naming the slot it was born in. Entries for the dead go
+// stale, to be popped once they reach the top or dropped when the heap is
+// rebuilt at twice the live count. Agents parked above num_agents are out of
+// play, so they are taken out of the sums, the score counts and the heap
+// until they are unparked; live and every figure here are of agents in play.
+class PopulationStats {
+public:
+  PopulationStats() : born_sum(0), score_sum(0), top_score(0) {
+    memset(&counts, 0, sizeof(counts));
+  }
+
+  void birth(uint64_t id, int slot, int frame) {
+    if (slot >= (int)slots.size()) {
+      slots.resize(slot + 1, Living());
+    }
+    Living entry = { id, frame, slot, false };
+    counts.births++;
+    enter(entry, 0);
+  }
+
+  // an agent parked when it died was already out of play
+  void death(uint64_t id, int slot, int born, int score, DeathCause cause) {
+    assert(slots[slot].id == id);
+    bool parked = slots[slot].parked;
+    slots[slot].id = 0;
+    counts.deaths[cause]++;
+    if (!parked) {
+      leave(born, score);
+    }
+  }
+
+  // an agent that had score before this meal
+  void meal(int score) {
+    counts.meals++;
+    add_score(score, -1);
+    add_score(score + 1, 1);
+  }
+
+  // the agent in this slot is parked, and out of play
+  void park(int slot, int score) {
+    assert(slots[slot].id && !slots[slot].parked);
+    slots[slot].parked = true;
+    leave(slots[slot].born, score);
+  }
+
+  // the parked agent in this slot is back in play, born as of born now
+  void unpark(int slot, int born, int score) {
+    assert(slots[slot].id && slots[slot].parked);
+    Living entry = { slots[slot].id, born, slot, false };
+    enter(entry, score);
+  }
+
+  void kill() {
+    counts.kills++;
+  }
+
+  void move(bool moved) {
+    counts.moves_attempted++;
+    counts.moves += moved;
+  }
+
+  void spawn(bool spawned) {
+    counts.spawns_attempted++;
+    counts.spawns += spawned;
+  }
+
+  int live() const {
+    return counts.live;
+  }
+
+  int64_t total_score() const {
+    return score_sum;
+  }
+
+  StatsSnapshot snapshot(int frame) const {
+    StatsSnapshot s = counts;
+    s.frame = frame;
+    if (s.live > 0) {
+      s.mean_age = frame - (float)((double)born_sum / s.live);
+      s.max_age = oldest.empty() ? 0 : frame - oldest.front().born;
+      s.mean_score = (float)((double)score_sum / s.live);
+      s.max_score = top_score;
+    }
+    return s;
+  }
+
+private:
+  struct Living {
+    uint64_t id;  // 0 for an empty slot
+    int born;
+    int slot;
+    bool parked;
+  };
+
+  StatsSnapshot counts;
+  std::vector<Living> slots;   // the agent in each slot
+  std::vector<Living> oldest;  // heap of agents in play, with stale entries
+  int64_t born_sum;
+  int64_t score_sum;
+  std::vector<int> scores;  // living agents at each score
+  int top_score;
+
+  static bool younger(const Living &a, const Living &b) {
+    return a.born > b.born;
+  }
+
+  // dead, parked, or unparked since and pushed again with a later birth
+  bool stale(const Living &entry) const {
+    const Living &now = slots[entry.slot];
+    return now.id != entry.id || now.parked || now.born != entry.born;
+  }
+
+  void enter(const Living &entry, int score) {
+    slots[entry.slot] = entry;
+    oldest.push_back(entry);
+    std::push_heap(oldest.begin(), oldest.end(), younger);
+    counts.live++;
+    born_sum += entry.born;
+    add_score(score, 1);
+  }
+
+  // once the slot is marked dead or parked, which makes its entry stale
+  void leave(int born, int score) {
+    counts.live--;
+    born_sum -= born;
+    add_score(score, -1);
+    while (top_score > 0 && scores[top_score] == 0) {
+      top_score--;
+    }
+    if (oldest.size() > 2 * (size_t)counts.live + 64) {
+      rebuild();
+    }
+    while (!oldest.empty() && stale(oldest.front())) {
+      std::pop_heap(oldest.begin(), oldest.end(), younger);
+      oldest.pop_back();
+    }
+  }
+
+  void rebuild() {
+    oldest.clear();
+    for (int slot = 0; slot < (int)slots.size(); slot++) {
+      if (slots[slot].id && !slots[slot].parked) {
+        oldest.push_back(slots[slot]);
+      }
+    }
+    std::make_heap(oldest.begin(), oldest.end(), younger);
+  }
+
+  void add_score(int score, int n) {
+    if (score >= (int)scores.size()) {
+      scores.resize(score + 1, 0);
+    }
+    scores[score] += n;
+    score_sum += (int64_t)score * n;
+    if (n > 0 && score > top_score) {
+      top_score = score;
+    }
+  }
+};
+
+#endif
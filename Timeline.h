@@ -0,0 +1,226 @@
+#ifndef __TIMELINE_H_
+#define __TIMELINE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// What the world view shows of one agent slot.
+struct AgentView {
+  float hue;
+  float health_points;  // as of touched
+  int born;
+  int touched;
+  uint8_t q, r, orientation;
+  bool out;
+};
+
+// The world view as of the end of one frame: every agent slot and every hex.
+struct WorldView {
+  int frame;
+  std::vector<AgentView> agents;
+  std::vector<char> food;
+};
+
+// One change to the world view, 16 bytes. Births and turns carry the
+// agent's whole view; touched is the frame of the change, and so is born
+// for a birth.
+struct TimelineDelta {
+  enum Kind { BIRTH, TURN, DEATH, FOOD };
+
+  int32_t frame;
+  uint32_t index : 24;  // agent slot, or hex for FOOD
+  uint32_t kind : 2;
+  uint32_t value : 6;   // orientation, or food for FOOD
+  uint8_t q, r;
+  uint16_t hue;         // births only, in 65535ths
+  float health_points;
+};
+
+static_assert(sizeof(TimelineDelta) == 16, "timeline deltas should stay 16 bytes");
+
+// A rewindable history of the world view. Every interval frames the whole
+// view is kept as a keyframe; between keyframes only the deltas are, in a
+// ring of fixed size. Seeking copies the last keyframe at or before the
+// frame and replays at most interval frames of deltas onto it, however long
+// the history. When the ring wraps, keyframes whose deltas have been
+// overwritten are dropped with them, so the oldest history goes first.
+class Timeline {
+public:
+  Timeline() : interval(1000), agent_count(0), capacity(0), first(0), end(0) {
+  }
+
+  // keeps room for max_deltas deltas; until then nothing is recorded
+  void allocate(int agents, int interval, size_t max_deltas) {
+    this->interval = interval;
+    agent_count = agents;
+    capacity = max_deltas;
+    ring.clear();
+    ring.reserve(capacity);
+    keyframes.clear();
+    first = end = 0;
+  }
+
+  bool recording() const {
+    return capacity > 0;
+  }
+
+  // there are more agent slots now; views seek()ed from here on have them all
+  void grow(int agents) {
+    agent_count = agents;
+  }
+
+  void birth(int frame, int agent, int q, int r, int orientation, float hue, float health_points) {
+    TimelineDelta d = delta(frame, TimelineDelta::BIRTH, agent, q, r, orientation);
+    d.hue = (uint16_t)(hue * 65535.0f + 0.5f);
+    d.health_points = health_points;
+    push(d);
+  }
+
+  void turn(int frame, int agent, int q, int r, int orientation, float health_points) {
+    TimelineDelta d = delta(frame, TimelineDelta::TURN, agent, q, r, orientation);
+    d.health_points = health_points;
+    push(d);
+  }
+
+  void death(int frame, int agent) {
+    push(delta(frame, TimelineDelta::DEATH, agent, 0, 0, 0));
+  }
+
+  void food(int frame, int hex, char value) {
+    push(delta(frame, TimelineDelta::FOOD, hex, 0, 0, (uint8_t)value));
+  }
+
+  bool keyframe_due(int frame) const {
+    return recording() && frame % interval == 0;
+  }
+
+  // the whole view at the end of its frame, which is after every delta so far
+  void keyframe(const WorldView &view) {
+    Keyframe k;
+    k.frame = view.frame;
+    k.offset = end;
+    for (int i = 0; i < (int)view.agents.size(); i++) {
+      if (!view.agents[i].out) {
+        k.slots.push_back((uint32_t)i);
+        k.agents.push_back(view.agents[i]);
+      }
+    }
+    k.food = view.food;
+    keyframes.push_back(k);
+  }
+
+  // the first frame seek() can reach, or -1 if none
+  int earliest() const {
+    return keyframes.empty() ? -1 : keyframes.front().frame;
+  }
+
+  // the view at the end of frame, or false if that is no longer kept
+  bool seek(int frame, WorldView &view) const {
+    int k = (int)keyframes.size() - 1;
+    while (k >= 0 && keyframes[k].frame > frame) {
+      k--;
+    }
+    if (k < 0) {
+      return false;
+    }
+    const Keyframe &key = keyframes[k];
+    AgentView out = { };
+    out.out = true;
+    view.frame = frame;
+    view.agents.assign(agent_count, out);
+    for (size_t i = 0; i < key.slots.size(); i++) {
+      view.agents[key.slots[i]] = key.agents[i];
+    }
+    view.food = key.food;
+    for (uint64_t s = key.offset; s < end; s++) {
+      const TimelineDelta &d = ring[s % capacity];
+      if (d.frame > frame) {
+        break;
+      }
+      apply(d, view);
+    }
+    return true;
+  }
+
+  size_t bytes() const {
+    size_t total = capacity * sizeof(TimelineDelta);
+    for (size_t k = 0; k < keyframes.size(); k++) {
+      total += keyframes[k].slots.size() * (sizeof(uint32_t) + sizeof(AgentView)) + keyframes[k].food.size();
+    }
+    return total;
+  }
+
+private:
+  struct Keyframe {
+    int frame;
+    uint64_t offset;  // the first delta after it
+    std::vector<uint32_t> slots;
+    std::vector<AgentView> agents;
+    std::vector<char> food;
+  };
+
+  int interval;
+  int agent_count;
+  size_t capacity;
+  std::vector<TimelineDelta> ring;
+  std::deque<Keyframe> keyframes;
+  uint64_t first, end;  // deltas kept, counted from the start of the run
+
+  static TimelineDelta delta(int frame, int kind, int index, int q, int r, int value) {
+    TimelineDelta d = { };
+    d.frame = frame;
+    d.kind = (uint32_t)kind;
+    d.index = (uint32_t)index;
+    d.q = (uint8_t)q;
+    d.r = (uint8_t)r;
+    d.value = (uint32_t)value;
+    return d;
+  }
+
+  void push(const TimelineDelta &d) {
+    if (capacity == 0) {
+      return;
+    }
+    if (ring.size() < capacity) {
+      ring.push_back(d);
+    } else {
+      ring[end % capacity] = d;
+    }
+    end++;
+    if (end - first > capacity) {
+      first++;
+      while (!keyframes.empty() && keyframes.front().offset < first) {
+        keyframes.pop_front();
+      }
+    }
+  }
+
+  static void apply(const TimelineDelta &d, WorldView &view) {
+    if (d.kind == TimelineDelta::FOOD) {
+      view.food[d.index] = (char)d.value;
+      return;
+    }
+    AgentView &agent = view.agents[d.index];
+    switch (d.kind) {
+    case TimelineDelta::BIRTH:
+      agent.out = false;
+      agent.born = d.frame;
+      agent.hue = d.hue / 65535.0f;
+      // fall through
+    case TimelineDelta::TURN:
+      agent.q = d.q;
+      agent.r = d.r;
+      agent.orientation = d.value;
+      agent.health_points = d.health_points;
+      agent.touched = d.frame;
+      break;
+    case TimelineDelta::DEATH:
+      agent.out = true;
+      break;
+    }
+  }
+};
+
+#endif
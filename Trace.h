@@ -0,0 +1,179 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "AgentPool.h"
+#include "Brain.h"
+
+// One decision of a traced agent: where it stood, what its network read,
+// thought and answered, and which behaviors that set off, a bit each by
+// output.
+struct TraceRecord {
+  int32_t frame;
+  int16_t q, r;
+  int8_t orientation;
+  uint8_t fired;
+  int16_t reserved;
+  float health_points;
+  float inputs[Brain::INPUTS];
+  float hidden[HIDDEN_SIZE];
+  float outputs[Brain::OUTPUTS];
+};
+
+struct TraceHeader {
+  enum { MAGIC = 0x544c4f50 };  // POLT
+
+  uint32_t magic;
+  uint32_t inputs, hidden, outputs;  // to read the records by
+  uint32_t record_size;
+  uint32_t rings;
+};
+
+// each ring in a dump, followed by count records, oldest first
+struct TraceRingHeader {
+  uint64_t id;  // in the lineage
+  uint32_t count;
+  uint32_t reserved;
+};
+
+static_assert(BEHAVIOR_COUNT <= 8, "trace records keep a byte of fired behaviors");
+
+// The last DEPTH decisions of up to RINGS selected agents, each in a ring
+// of its own, all of them allocated up front. Nothing is written unless an
+// agent is selected, and the step loop asks active() before anything else,
+// so tracing costs one branch a decision until it is used.
+//
+// When a traced agent dies its ring is ended: free to be taken again, but
+// holding the agent's last decisions for a dump until it is.
+class Tracer {
+public:
+  enum { RINGS = 8, DEPTH = 256 };
+
+  Tracer() : selected(0) {
+    for (int t = 0; t < RINGS; t++) {
+      rings[t].handle = 0;
+      rings[t].count = 0;
+      rings[t].taken = -1;
+    }
+  }
+
+  bool active() const {
+    return selected > 0;
+  }
+
+  // the ring tracing the agent, or -1
+  int ring_of(AgentHandle handle) const {
+    for (int t = 0; t < RINGS; t++) {
+      if (handle && rings[t].handle == handle) {
+        return t;
+      }
+    }
+    return -1;
+  }
+
+  // Starts tracing an agent from frame on, in a free ring, or else the one
+  // taken longest ago; either way the decisions it held are dropped.
+  void select(AgentHandle handle, uint64_t id, int frame) {
+    if (ring_of(handle) >= 0) {
+      return;
+    }
+    int t = 0;
+    for (int u = 1; u < RINGS; u++) {
+      bool free = !rings[u].handle, t_free = !rings[t].handle;
+      if (free != t_free ? free : rings[u].taken < rings[t].taken) {
+        t = u;
+      }
+    }
+    if (!rings[t].handle) {
+      selected++;
+    }
+    rings[t].handle = handle;
+    rings[t].id = id;
+    rings[t].count = 0;
+    rings[t].taken = frame;
+  }
+
+  // stops tracing an agent and drops its decisions
+  void deselect(AgentHandle handle) {
+    int t = ring_of(handle);
+    if (t >= 0) {
+      end(handle);
+      rings[t].count = 0;
+      rings[t].taken = -1;
+    }
+  }
+
+  // stops tracing an agent that has died, keeping its decisions
+  void end(AgentHandle handle) {
+    int t = ring_of(handle);
+    if (t >= 0) {
+      rings[t].handle = 0;
+      selected--;
+    }
+  }
+
+  // rings a dump would write: those selected or holding decisions
+  int kept() const {
+    int n = 0;
+    for (int t = 0; t < RINGS; t++) {
+      n += rings[t].handle || rings[t].count;
+    }
+    return n;
+  }
+
+  // the next record of a ring to fill in, over its oldest once it is full
+  TraceRecord &record(int ring) {
+    Ring &r = rings[ring];
+    return r.records[r.count++ % DEPTH];
+  }
+
+  // how many decisions a ring holds, and the one back decisions ago
+  int size(int ring) const {
+    return rings[ring].count < DEPTH ? (int)rings[ring].count : DEPTH;
+  }
+
+  const TraceRecord &back(int ring, int ago) const {
+    const Ring &r = rings[ring];
+    return r.records[(r.count - 1 - ago) % DEPTH];
+  }
+
+  // every kept ring, oldest decisions first
+  bool dump(const std::string &path) const {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+      printf("trace: could not open %s\n", path.c_str());
+      return false;
+    }
+    TraceHeader header = { TraceHeader::MAGIC, Brain::INPUTS, HIDDEN_SIZE, Brain::OUTPUTS,
+                           sizeof(TraceRecord), (uint32_t)kept() };
+    fwrite(&header, sizeof(header), 1, file);
+    for (int t = 0; t < RINGS; t++) {
+      if (!rings[t].handle && !rings[t].count) {
+        continue;
+      }
+      TraceRingHeader ring = { rings[t].id, (uint32_t)size(t), 0 };
+      fwrite(&ring, sizeof(ring), 1, file);
+      for (int ago = size(t) - 1; ago >= 0; ago--) {
+        fwrite(&back(t, ago), sizeof(TraceRecord), 1, file);
+      }
+    }
+    fclose(file);
+    return true;
+  }
+
+private:
+  struct Ring {
+    AgentHandle handle;  // 0 for a free ring
+    uint64_t id;
+    uint32_t count;      // decisions written, of which the last DEPTH are kept
+    int taken;           // the frame it was selected in, or -1
+    TraceRecord records[DEPTH];
+  };
+
+  int selected;
+  Ring rings[RINGS];
+};
+
+#endif
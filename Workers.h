@@ -0,0 +1,99 @@
+#ifndef __WORKERS_H_
+#define __WORKERS_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that split loops between them. The calling thread
+// does a share of every loop itself, so Workers(1) starts no threads at all
+// and runs everything inline.
+class Workers {
+public:
+  explicit Workers(int threads = 1) : generation(0), pending(0), stopping(false) {
+    for (int t = 1; t < threads; t++) {
+      pool.push_back(std::thread(&Workers::work, this, t));
+    }
+  }
+
+  ~Workers() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (size_t t = 0; t < pool.size(); t++) {
+      pool[t].join();
+    }
+  }
+
+  int size() const {
+    return (int)pool.size() + 1;
+  }
+
+  // Calls f(begin, end) on disjoint ranges covering [0, count), one range
+  // per thread, and returns once all of them have. Every range but the last
+  // starts and ends on a multiple of grain.
+  void parallel_for(int count, int grain, const std::function<void(int, int)> &f) {
+    int chunks = (count + grain - 1) / grain;
+    chunk = std::max((chunks + size() - 1) / size(), 1) * grain;
+    if (pool.empty() || chunk >= count) {
+      f(0, count);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      task = &f;
+      total = count;
+      pending = (int)pool.size();
+      generation++;
+    }
+    wake.notify_all();
+    f(0, std::min(chunk, count));
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    task = 0;
+  }
+
+private:
+  std::vector<std::thread> pool;
+  std::mutex mutex;
+  std::condition_variable wake, done;
+  const std::function<void(int, int)> *task;
+  int total, chunk;
+  unsigned generation;
+  int pending;
+  bool stopping;
+
+  void work(int t) {
+    unsigned seen = 0;
+    while (true) {
+      const std::function<void(int, int)> *f;
+      int begin, end;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+        if (stopping) {
+          return;
+        }
+        seen = generation;
+        f = task;
+        begin = std::min(t * chunk, total);
+        end = std::min(begin + chunk, total);
+      }
+      if (begin < end) {
+        (*f)(begin, end);
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending--;
+      }
+      done.notify_one();
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,602 @@
+//
+// Patterns of Life benchmarks, headless
+//
+//   ./bench [name]
+//
+//   genome     fp16 and int8 genomes against fp32: size, speed, divergence
+//   activation the tanh tiers against libm: error, speed, changed decisions
+//   rng        bulk random numbers and skip sampled mutation against std::
+//   species    joining a species and recentering, at max_agents
+//   mlp        MlpBatch against a scalar network computed as FANN does
+//
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <vector>
+#include "Brain.h"
+#include "MlpBatch.h"
+#include "Random.h"
+#include "Species.h"
+
+using namespace std::chrono;
+
+static std::mt19937 gen(1);
+static std::uniform_real_distribution<float> fdis(0, 1);
+static std::normal_distribution<float> norm_dist(0, 1);
+
+// defaults from config
+const float DNA_MULTIPLIER = 0.70f;
+const float MUTATE_RATE = 0.10f;
+const float MUTATE_AMOUNT = 0.01f;
+
+const float FOOD_DENSITY = 0.3f;
+
+static volatile float sink;
+
+void random_dna(float *dna) {
+  for (int i = 0; i < DNA_SIZE; i++) {
+    dna[i] = norm_dist(gen) * DNA_MULTIPLIER;
+  }
+}
+
+// one set of sensor readings, food sensors are 0 or 1, health is in [0, 1]
+void random_sensors(float (&inputs)[Brain::INPUTS]) {
+  for (int i = 0; i < SENSOR_COUNT - 1; i++) {
+    inputs[i] = fdis(gen) < FOOD_DENSITY ? 1.0f : 0.0f;
+  }
+  inputs[SENSOR_COUNT - 1] = fdis(gen);
+}
+
+// the decisions step() makes from one network evaluation, packed in a word
+template <typename Tanh = TanhExact, typename G>
+int decide(const G &genome, float (&inputs)[Brain::INPUTS], float (&memory)[MEMORY_SIZE]) {
+  for (int m = 0; m < MEMORY_SIZE; m++) {
+    inputs[SENSOR_COUNT + m] = memory[m];
+  }
+  float hidden[HIDDEN_SIZE], outputs[Brain::OUTPUTS], gains[Brain::OUTPUTS];
+  genome.template forward<Tanh>(inputs, hidden, outputs);
+  genome.gains(gains);
+  int decision = 0;
+  for (int k = 0; k < BEHAVIOR_COUNT; k++) {
+    if (k == 3) {
+      float rotation = outputs[k] * gains[k];
+      decision |= (rotation < -0.5f ? 1 : rotation > 0.5f ? 2 : 0) << (2 * k);
+    } else {
+      decision |= (outputs[k] > gains[k] ? 1 : 0) << (2 * k);
+    }
+  }
+  for (int m = 0; m < MEMORY_SIZE; m++) {
+    memory[m] = outputs[BEHAVIOR_COUNT + m] * gains[BEHAVIOR_COUNT + m];
+  }
+  return decision;
+}
+
+template <typename Tanh = TanhExact, typename G>
+double time_forward(const G *genomes, int count, const float (*inputs)[Brain::INPUTS], int input_count) {
+  const int REPEATS = 20;
+  float hidden[HIDDEN_SIZE], outputs[Brain::OUTPUTS];
+  float total = 0.0f;
+  auto start = steady_clock::now();
+  for (int r = 0; r < REPEATS; r++) {
+    for (int g = 0; g < count; g++) {
+      genomes[g].template forward<Tanh>(inputs[(g + r) % input_count], hidden, outputs);
+      total += outputs[0];
+    }
+  }
+  auto end = steady_clock::now();
+  sink = total;
+  return duration_cast<nanoseconds>(end - start).count() / (double)(REPEATS * count);
+}
+
+template <typename G>
+void report_genome(const char *name, const G *genomes, const Genome<Brain, float> *reference, int count) {
+  const int ROLLOUTS = 4;
+  const int ROLLOUT_LENGTH = 250;
+
+  // recurrent rollouts over shared sensor readings, each precision carrying
+  // its own memory, so divergence compounds the way it would in a run
+  long steps = 0, diverged_steps = 0, diverged_decisions = 0;
+  double output_error = 0.0;
+  for (int g = 0; g < count; g++) {
+    for (int r = 0; r < ROLLOUTS; r++) {
+      float memory[MEMORY_SIZE] = { }, reference_memory[MEMORY_SIZE] = { };
+      for (int s = 0; s < ROLLOUT_LENGTH; s++) {
+        float inputs[Brain::INPUTS], reference_inputs[Brain::INPUTS];
+        random_sensors(inputs);
+        memcpy(reference_inputs, inputs, sizeof(inputs));
+        int decision = decide(genomes[g], inputs, memory);
+        int expected = decide(reference[g], reference_inputs, reference_memory);
+        steps++;
+        if (decision != expected) {
+          diverged_steps++;
+          for (int k = 0; k < BEHAVIOR_COUNT; k++) {
+            diverged_decisions += ((decision >> (2 * k)) & 3) != ((expected >> (2 * k)) & 3);
+          }
+        }
+        for (int m = 0; m < MEMORY_SIZE; m++) {
+          output_error += fabs(memory[m] - reference_memory[m]) / MEMORY_SIZE;
+        }
+      }
+    }
+  }
+
+  // the same lineage of mutations applied at both precisions
+  const int GENERATIONS = 1000;
+  double drift = 0.0, drift_error = 0.0;
+  for (int g = 0; g < count / 10; g++) {
+    G genome = genomes[g];
+    Genome<Brain, float> exact = reference[g];
+    for (int n = 0; n < GENERATIONS; n++) {
+      for (int i = 0; i < DNA_SIZE; i++) {
+        if (fdis(gen) < MUTATE_RATE) {
+          float delta = norm_dist(gen) * MUTATE_AMOUNT;
+          exact.mutate(i, delta, 0.0f);
+          genome.mutate(i, delta, fdis(gen));
+        }
+      }
+    }
+    for (int i = 0; i < DNA_SIZE; i++) {
+      drift += fabs(exact.get(i) - reference[g].get(i));
+      drift_error += fabs(genome.get(i) - exact.get(i));
+    }
+  }
+
+  float (*inputs)[Brain::INPUTS] = new float[count][Brain::INPUTS];
+  for (int i = 0; i < count; i++) {
+    random_sensors(inputs[i]);
+  }
+  double ns = time_forward(genomes, count, inputs, count);
+  delete[] inputs;
+
+  printf("%-5s %4d bytes  %6.1f ns/forward  %6.2f%% steps diverged  %6.3f%% decisions diverged  "
+         "memory error %.5f  mutation drift error %.1f%%\n",
+         name, (int)sizeof(G), ns,
+         100.0 * diverged_steps / steps,
+         100.0 * diverged_decisions / (steps * BEHAVIOR_COUNT),
+         output_error / steps,
+         drift > 0.0 ? 100.0 * drift_error / drift : 0.0);
+}
+
+void bench_genome() {
+  const int COUNT = 2000;
+  printf("genome: %d genomes of %d genes, %d step rollouts\n", COUNT, DNA_SIZE, 250);
+  Genome<Brain, float> *fp32 = new Genome<Brain, float>[COUNT];
+  Genome<Brain, Half> *fp16 = new Genome<Brain, Half>[COUNT];
+  Genome<Brain, int8_t> *int8 = new Genome<Brain, int8_t>[COUNT];
+  for (int g = 0; g < COUNT; g++) {
+    float dna[DNA_SIZE];
+    random_dna(dna);
+    fp32[g].assign(dna);
+    fp16[g].assign(dna);
+    int8[g].assign(dna);
+  }
+  report_genome("fp32", fp32, fp32, COUNT);
+  report_genome("fp16", fp16, fp32, COUNT);
+  report_genome("int8", int8, fp32, COUNT);
+  delete[] fp32;
+  delete[] fp16;
+  delete[] int8;
+}
+
+// inputs recorded from exact rollouts, replayed one step at a time under
+// each tier, so every tier decides from the same inputs
+struct Recording {
+  enum { ROLLOUTS = 4, ROLLOUT_LENGTH = 250, STEPS = ROLLOUTS * ROLLOUT_LENGTH };
+
+  int count;
+  std::vector<float> inputs;  // [genome][step][input], memory included
+  std::vector<int> decisions;
+  std::vector<float> memory;  // [genome][step][cell] after each step
+};
+
+template <typename G>
+void record(const G *genomes, int count, Recording &recording) {
+  recording.count = count;
+  recording.inputs.resize((size_t)count * Recording::STEPS * Brain::INPUTS);
+  recording.decisions.resize((size_t)count * Recording::STEPS);
+  recording.memory.resize((size_t)count * Recording::STEPS * MEMORY_SIZE);
+  for (int g = 0; g < count; g++) {
+    for (int r = 0; r < Recording::ROLLOUTS; r++) {
+      float memory[MEMORY_SIZE] = { };
+      for (int s = 0; s < Recording::ROLLOUT_LENGTH; s++) {
+        size_t step = (size_t)g * Recording::STEPS + r * Recording::ROLLOUT_LENGTH + s;
+        float inputs[Brain::INPUTS];
+        random_sensors(inputs);
+        recording.decisions[step] = decide(genomes[g], inputs, memory);
+        memcpy(&recording.inputs[step * Brain::INPUTS], inputs, sizeof(inputs));
+        memcpy(&recording.memory[step * MEMORY_SIZE], memory, sizeof(memory));
+      }
+    }
+  }
+}
+
+template <typename Tanh>
+void report_activation(const char *name, const Genome<Brain, float> *genomes, const Recording &recording) {
+  // the function itself, swept densely over where the networks use it
+  Tanh activate;
+  double max_error = 0.0, mean_error = 0.0;
+  const int SAMPLES = 1 << 20;
+  for (int i = 0; i < SAMPLES; i++) {
+    float x = -10.0f + 20.0f * i / SAMPLES;
+    double error = fabs(activate(x) - tanh((double)x));
+    max_error = std::max(max_error, error);
+    mean_error += error / SAMPLES;
+  }
+  float xs[1024];
+  for (int i = 0; i < 1024; i++) {
+    xs[i] = norm_dist(gen) * 2.0f;
+  }
+  const int REPEATS = 1000;
+  float total = 0.0f;
+  auto start = steady_clock::now();
+  for (int r = 0; r < REPEATS; r++) {
+    for (int i = 0; i < 1024; i++) {
+      total += activate(xs[i]);
+    }
+  }
+  double call = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)(REPEATS * 1024);
+  sink = total;
+
+  // the decisions the exact rollouts made, taken again from their inputs
+  long steps = 0, changed_steps = 0, changed_decisions = 0;
+  double memory_error = 0.0;
+  for (int g = 0; g < recording.count; g++) {
+    for (int s = 0; s < Recording::STEPS; s++) {
+      size_t step = (size_t)g * Recording::STEPS + s;
+      float inputs[Brain::INPUTS], memory[MEMORY_SIZE];
+      memcpy(inputs, &recording.inputs[step * Brain::INPUTS], sizeof(inputs));
+      memcpy(memory, &inputs[SENSOR_COUNT], sizeof(memory));
+      int decision = decide<Tanh>(genomes[g], inputs, memory);
+      int expected = recording.decisions[step];
+      steps++;
+      if (decision != expected) {
+        changed_steps++;
+        for (int k = 0; k < BEHAVIOR_COUNT; k++) {
+          changed_decisions += ((decision >> (2 * k)) & 3) != ((expected >> (2 * k)) & 3);
+        }
+      }
+      for (int m = 0; m < MEMORY_SIZE; m++) {
+        memory_error += fabs(memory[m] - recording.memory[step * MEMORY_SIZE + m]) / MEMORY_SIZE;
+      }
+    }
+  }
+
+  const float (*inputs)[Brain::INPUTS] = reinterpret_cast<const float (*)[Brain::INPUTS]>(recording.inputs.data());
+  double ns = time_forward<Tanh>(genomes, recording.count, inputs, recording.count * Recording::STEPS);
+
+  printf("%-8s max error %.1e  mean error %.1e  %5.2f ns/tanh  %6.1f ns/forward  "
+         "%6.3f%% steps changed  %6.4f%% decisions changed  memory error %.2e\n",
+         name, max_error, mean_error, call, ns,
+         100.0 * changed_steps / steps,
+         100.0 * changed_decisions / (steps * BEHAVIOR_COUNT),
+         memory_error / steps);
+}
+
+void bench_activation() {
+  const int COUNT = 2000;
+  Genome<Brain, float> *genomes = new Genome<Brain, float>[COUNT];
+  for (int g = 0; g < COUNT; g++) {
+    float dna[DNA_SIZE];
+    random_dna(dna);
+    genomes[g].assign(dna);
+  }
+  Recording recording;
+  record(genomes, COUNT, recording);
+  printf("activation: %d genomes, %d recorded steps each\n", COUNT, (int)Recording::STEPS);
+  report_activation<TanhExact>(ACTIVATION_NAMES[ACTIVATION_EXACT], genomes, recording);
+  report_activation<TanhRational>(ACTIVATION_NAMES[ACTIVATION_RATIONAL], genomes, recording);
+  report_activation<TanhTable>(ACTIVATION_NAMES[ACTIVATION_TABLE], genomes, recording);
+  delete[] genomes;
+}
+
+void bench_rng() {
+  const int COUNT = 1 << 20;
+  const int BIRTHS = 100000;
+  float *out = new float[COUNT];
+  Random random(1);
+  std::mt19937 mt(1);
+  float total = 0.0f;
+
+  auto start = steady_clock::now();
+  for (int i = 0; i < COUNT; i++) {
+    out[i] = fdis(mt);
+  }
+  double std_uniform = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)COUNT;
+  total += out[COUNT - 1];
+  start = steady_clock::now();
+  random.uniforms(out, COUNT);
+  double bulk_uniform = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)COUNT;
+  total += out[COUNT - 1];
+
+  start = steady_clock::now();
+  for (int i = 0; i < COUNT; i++) {
+    out[i] = norm_dist(mt);
+  }
+  double std_normal = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)COUNT;
+  total += out[COUNT - 1];
+  start = steady_clock::now();
+  random.normals(out, COUNT);
+  double bulk_normal = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)COUNT;
+  double mean = 0.0, variance = 0.0, kurtosis = 0.0;
+  for (int i = 0; i < COUNT; i++) {
+    mean += out[i];
+    variance += out[i] * out[i];
+    kurtosis += out[i] * out[i] * out[i] * out[i];
+  }
+  mean /= COUNT;
+  variance /= COUNT;
+  kurtosis /= COUNT;
+
+  // the mutation loop of init_from_parent, per gene and skip sampled
+  float genes[DNA_SIZE] = { };
+  long mutations = 0;
+  start = steady_clock::now();
+  for (int b = 0; b < BIRTHS; b++) {
+    for (int i = 0; i < DNA_SIZE; i++) {
+      if (fdis(mt) < MUTATE_RATE) {
+        genes[i] += norm_dist(mt) * MUTATE_AMOUNT;
+        mutations++;
+      }
+    }
+  }
+  double std_birth = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)BIRTHS;
+  long skip_mutations = 0;
+  start = steady_clock::now();
+  for (int b = 0; b < BIRTHS; b++) {
+    for (int i = random.skip(MUTATE_RATE); i < DNA_SIZE; i += 1 + random.skip(MUTATE_RATE)) {
+      genes[i] += random.normal() * MUTATE_AMOUNT;
+      skip_mutations++;
+    }
+  }
+  double skip_birth = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)BIRTHS;
+  sink = total + genes[0];
+
+  printf("rng: %d draws, %d births\n", COUNT, BIRTHS);
+  printf("uniform  std %6.2f ns  bulk %6.2f ns\n", std_uniform, bulk_uniform);
+  printf("normal   std %6.2f ns  bulk %6.2f ns  (mean %.4f, variance %.4f, kurtosis %.4f)\n",
+         std_normal, bulk_normal, mean, variance, kurtosis);
+  printf("birth    per gene %6.1f ns (%.2f mutations)  skip sampled %6.1f ns (%.2f mutations)\n",
+         std_birth, (double)mutations / BIRTHS, skip_birth, (double)skip_mutations / BIRTHS);
+  delete[] out;
+}
+
+void bench_species() {
+  const int AGENTS = 2000;
+  const int FOUNDERS = 20;
+  const int RECENTERS = 100;
+
+  // families of mutants around a few founders, like a run's population
+  float (*genes)[DNA_SIZE] = new float[AGENTS][DNA_SIZE];
+  for (int a = 0; a < AGENTS; a++) {
+    if (a < FOUNDERS) {
+      random_dna(genes[a]);
+      continue;
+    }
+    memcpy(genes[a], genes[a % FOUNDERS], sizeof(genes[a]));
+    for (int i = 0; i < DNA_SIZE; i++) {
+      if (fdis(gen) < MUTATE_RATE) {
+        genes[a][i] += norm_dist(gen) * MUTATE_AMOUNT * 10.0f;
+      }
+    }
+  }
+
+  printf("species: %d agents around %d founders\n", AGENTS, FOUNDERS);
+  const char *names[] = { "l2", "cosine" };
+  const float thresholds[] = { 2.0f, 0.02f };
+  for (int m = 0; m < 2; m++) {
+    Species *species = new Species;
+    species->configure((Species::Metric)m, thresholds[m]);
+    int *members = new int[AGENTS];
+    auto start = steady_clock::now();
+    for (int a = 0; a < AGENTS; a++) {
+      members[a] = species->join(genes[a], a / (float)AGENTS);
+    }
+    double join = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)AGENTS;
+    start = steady_clock::now();
+    for (int r = 0; r < RECENTERS; r++) {
+      species->begin_recenter();
+      for (int a = 0; a < AGENTS; a++) {
+        species->accumulate(members[a], genes[a]);
+      }
+      species->end_recenter();
+    }
+    double recenter = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)RECENTERS;
+    printf("%-6s %2d species  join %6.1f ns  recenter %7.1f us\n", names[m], species->count(), join, recenter / 1000.0);
+    delete[] members;
+    delete species;
+  }
+  delete[] genes;
+}
+
+// One network computed the way FANN computes a standard network with
+// symmetric sigmoid activations at steepness 0.5, trained incrementally
+// with the tanh error function and no momentum: fann_run, then
+// fann_compute_MSE, fann_backpropagate_MSE and fann_update_weights. Weights
+// are laid out and drawn in the order MlpBatch::randomize() draws them.
+template <int INPUTS, int HIDDEN, int OUTPUTS>
+struct FannReference {
+  float w1[HIDDEN][INPUTS + 1], w2[HIDDEN][HIDDEN + 1], w3[OUTPUTS][HIDDEN + 1];
+  float h1[HIDDEN], h2[HIDDEN], out[OUTPUTS];
+
+  void randomize(Random &rng, float lo, float hi) {
+    for (int o = 0; o < HIDDEN; o++)
+      for (int i = 0; i <= INPUTS; i++)
+        w1[o][i] = lo + (hi - lo) * rng.uniform();
+    for (int o = 0; o < HIDDEN; o++)
+      for (int i = 0; i <= HIDDEN; i++)
+        w2[o][i] = lo + (hi - lo) * rng.uniform();
+    for (int o = 0; o < OUTPUTS; o++)
+      for (int i = 0; i <= HIDDEN; i++)
+        w3[o][i] = lo + (hi - lo) * rng.uniform();
+  }
+
+  // fann_sigmoid_symmetric, and its derivative at the clipped output
+  static float activation(float sum) {
+    return 2.0f / (1.0f + expf(-2.0f * 0.5f * sum)) - 1.0f;
+  }
+
+  static float derived(float y) {
+    y = y < -0.98f ? -0.98f : y > 0.98f ? 0.98f : y;
+    return 0.5f * (1.0f - y * y);
+  }
+
+  // the bias neuron is the last of each layer, always 1
+  template <int IN, int OUT>
+  static void layer(const float (&w)[OUT][IN + 1], const float *in, float *y) {
+    for (int o = 0; o < OUT; o++) {
+      float sum = 0.0f;
+      for (int i = 0; i < IN; i++) {
+        sum += w[o][i] * in[i];
+      }
+      sum += w[o][IN];
+      y[o] = activation(sum);
+    }
+  }
+
+  template <int IN, int OUT>
+  static void back(const float (&w)[OUT][IN + 1], const float *errors, const float *in, float *in_errors) {
+    for (int i = 0; i < IN; i++) {
+      in_errors[i] = 0.0f;
+      for (int o = 0; o < OUT; o++) {
+        in_errors[i] += errors[o] * w[o][i];
+      }
+      in_errors[i] *= derived(in[i]);
+    }
+  }
+
+  template <int IN, int OUT>
+  static void update(float (&w)[OUT][IN + 1], const float *in, const float *errors, float rate) {
+    for (int o = 0; o < OUT; o++) {
+      float delta = rate * errors[o];
+      for (int i = 0; i < IN; i++) {
+        w[o][i] += delta * in[i];
+      }
+      w[o][IN] += delta;
+    }
+  }
+
+  void run(const float *in) {
+    layer<INPUTS, HIDDEN>(w1, in, h1);
+    layer<HIDDEN, HIDDEN>(w2, h1, h2);
+    layer<HIDDEN, OUTPUTS>(w3, h2, out);
+  }
+
+  void train(const float *in, const float *desired, float rate) {
+    run(in);
+    float e1[HIDDEN], e2[HIDDEN], e3[OUTPUTS];
+    for (int k = 0; k < OUTPUTS; k++) {
+      float diff = (desired[k] - out[k]) / 2.0f;
+      float error = diff < -0.9999999f ? -17.0f : diff > 0.9999999f ? 17.0f : logf((1.0f + diff) / (1.0f - diff));
+      e3[k] = error * derived(out[k]);
+    }
+    back<HIDDEN, OUTPUTS>(w3, e3, h2, e2);
+    back<HIDDEN, HIDDEN>(w2, e2, h1, e1);
+    update<INPUTS, HIDDEN>(w1, in, e1, rate);
+    update<HIDDEN, HIDDEN>(w2, h1, e2, rate);
+    update<HIDDEN, OUTPUTS>(w3, h2, e3, rate);
+  }
+};
+
+// MlpBatch, at the exact tanh, holds to the FANN reference through run(),
+// run_one() and train(); the error left is the batch's approximate log.
+void bench_mlp() {
+  enum { INPUTS = 4, HIDDEN = 7, OUTPUTS = 2 };
+  const int AGENTS = 1003;
+  const int STEPS = 200;
+  const float TOLERANCE = 1e-4f;
+  typedef MlpBatch<INPUTS, HIDDEN, OUTPUTS, TanhExact> Batch;
+  typedef FannReference<INPUTS, HIDDEN, OUTPUTS> Reference;
+
+  Batch batch(AGENTS);
+  Reference *reference = new Reference[AGENTS];
+  std::vector<float> rates(AGENTS);
+  Random weights(1);
+  for (int a = 0; a < AGENTS; a++) {
+    Random copy = weights;
+    batch.randomize(a, weights, -0.1f, 0.1f);
+    reference[a].randomize(copy, -0.1f, 0.1f);
+    // some agents are left untrained, as buddies leaves its leader
+    rates[a] = a % 10 == 0 ? 0.0f : 0.7f * (1 + a % 3) / 3.0f;
+  }
+
+  Random examples(2);
+  float in[INPUTS], desired[OUTPUTS];
+  float trained = 0.0f;
+  for (int step = 0; step < STEPS; step++) {
+    examples.uniforms(in, INPUTS);
+    for (int k = 0; k < OUTPUTS; k++) {
+      desired[k] = examples.uniform() < 0.5f ? -1.0f : 1.0f;
+    }
+    batch.train(in, desired, rates.data());
+    for (int a = 0; a < AGENTS; a++) {
+      reference[a].train(in, desired, rates[a]);
+    }
+    // train() leaves the outputs of its forward pass, before the update
+    for (int k = 0; k < OUTPUTS; k++) {
+      for (int a = 0; a < AGENTS; a++) {
+        trained = std::max(trained, fabsf(batch.output(k)[a] - reference[a].out[k]));
+      }
+    }
+  }
+
+  float ran = 0.0f;
+  for (int a = 0; a < AGENTS; a++) {
+    for (int i = 0; i < INPUTS; i++) {
+      batch.input(i)[a] = (float)((a + i) % 5) / 2.0f - 1.0f;
+    }
+  }
+  batch.run();
+  for (int a = 0; a < AGENTS; a++) {
+    float x[INPUTS], one[OUTPUTS];
+    for (int i = 0; i < INPUTS; i++) {
+      x[i] = (float)((a + i) % 5) / 2.0f - 1.0f;
+    }
+    reference[a].run(x);
+    batch.run_one(a, x, one);
+    for (int k = 0; k < OUTPUTS; k++) {
+      ran = std::max(ran, fabsf(batch.output(k)[a] - reference[a].out[k]));
+      ran = std::max(ran, fabsf(one[k] - reference[a].out[k]));
+    }
+  }
+
+  printf("mlp: %d agents %d-%d-%d-%d, %d training steps against FANN's formulas\n",
+         AGENTS, INPUTS, HIDDEN, HIDDEN, OUTPUTS, STEPS);
+  printf("max |batch - fann|  training %.2e  after %.2e\n", trained, ran);
+  assert(trained < TOLERANCE && ran < TOLERANCE);
+  delete[] reference;
+}
+
+int main(int argc, char *argv[]) {
+  const char *name = argc > 1 ? argv[1] : "all";
+  bool all = strcmp(name, "all") == 0;
+  bool ran = false;
+  if (all || strcmp(name, "genome") == 0) {
+    bench_genome();
+    ran = true;
+  }
+  if (all || strcmp(name, "activation") == 0) {
+    bench_activation();
+    ran = true;
+  }
+  if (all || strcmp(name, "rng") == 0) {
+    bench_rng();
+    ran = true;
+  }
+  if (all || strcmp(name, "species") == 0) {
+    bench_species();
+    ran = true;
+  }
+  if (all || strcmp(name, "mlp") == 0) {
+    bench_mlp();
+    ran = true;
+  }
+  if (!ran) {
+    printf("unknown benchmark: %s\n", name);
+    return 1;
+  }
+  return 0;
+}
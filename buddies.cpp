@@ -2,19 +2,35 @@
 #include <cmath>
 #include <random>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <set>
-#include <fann.h>
-#ifdef __EMSCRIPTEN__
+#ifdef BUDDIES_HEADLESS
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#elif defined(__EMSCRIPTEN__)
 #include "easygame_emscripten.h"
 #include <emscripten.h>
 #else
 #include "easygame.h"
 #endif
+#include "Random.h"
+#include "MlpBatch.h"
+#include "Workers.h"
 
 
 using std::min;
 using std::max;
 
+#ifdef BUDDIES_HEADLESS
+// easygame's, without the window that comes with it
+template<typename T>
+T clamp(const T &x, const T &a, const T &b) {
+  return std::max(std::min(x, b), a);
+}
+#endif
+
 const float PI = 3.14159265359f;
 const int   TURBO_RATE = 240; // how many simulation steps per render
 const int   WIDTH = 1280;
@@ -26,7 +42,6 @@ const float GRID_CELL_HEIGHT = (float)HEIGHT / (float)GRID_HEIGHT;
 const float DT = 1.0f/60.0f;
 const float BUDDY_SIZE = 10.0f;
 const float FOOD_SIZE = 6.0f;
-const int   FOOD_COUNT = 400;
 const float FOOD_VALUE = 100.0f;
 const float FLOW_DX = -0.100f;
 const float FLOW_DY = +0.005f;
@@ -37,10 +52,26 @@ const float MAX_HEALTH = 100.0f;
 const float AGENT_MAX_FORCE = 100.0f;
 const float AGENT_MAX_ROTATIONAL_FORCE = M_PI / 40.0f;
 const float LEARNING_RATE = 0.010f;
-const int   MAX_PARTICLES = 1024;
 const float PARTICLE_VEL_DAMPING = 0.5f;
-
-const int NUM_AGENTS = 10;
+const int   DEATH_PARTICLES = 100;
+
+// set at startup from the command line, see read_settings()
+static int num_agents = 10;
+static int food_count = 400;
+static int max_particles = 1024;
+#ifdef BUDDIES_HEADLESS
+// Built with BUDDIES_HEADLESS, buddies has no window and no sound: it runs
+// steps steps of DT from seed as fast as they go and reports on them.
+static int steps = 100000;
+static int seed = 1;
+#else
+static int seed = 0;  // 0 for one from the device
+#endif
+#ifdef __EMSCRIPTEN__
+static int num_threads = 1;
+#else
+static int num_threads = std::thread::hardware_concurrency();
+#endif
 
 // in  1: radians to food
 // in  2: distance to food
@@ -54,8 +85,9 @@ const int ANN_NUM_OUTPUT = 2;
 
 
 static std::random_device rd;
-static std::mt19937 gen(rd());
-static std::uniform_real_distribution<float> fdis(0, 1);
+static Random rng((uint64_t)rd() << 32 | rd());
+// for particles, so that what is drawn does not change what happens
+static Random effects_rng((uint64_t)rd() << 32 | rd());
 
 
 float angle_diff(float a, float b);
@@ -65,8 +97,30 @@ enum GridCell {
   GridCellFull
 };
 
+// foods as parallel arrays, so the drift loop runs a vector at a time
+struct Foods {
+  std::vector<float> x, y;
+  std::vector<float> dx, dy;
+  std::vector<float> value;
+
+  void resize(int count) {
+    x.resize(count);
+    y.resize(count);
+    dx.resize(count);
+    dy.resize(count);
+    value.resize(count);
+  }
+};
+
+// Foods are bucketed by the cell they are in, each cell holding a linked
+// list threaded through food_next/food_prev. A cell is full while its list
+// is not empty.
 struct Grid {
   GridCell cells[GRID_WIDTH * GRID_HEIGHT];
+  int food_heads[GRID_WIDTH * GRID_HEIGHT];
+  std::vector<int> food_next;
+  std::vector<int> food_prev;
+  std::vector<int> food_cell;
 
   GridCell &cell(int x, int y) {
     assert(x >= 0 && x < GRID_WIDTH && y >= 0 && y < GRID_HEIGHT);
@@ -75,19 +129,120 @@ struct Grid {
 
   GridCell &cell_at(float x, float y) {
     assert(x >= 0.0f && x <= WIDTH && y >= 0.0f && y <= HEIGHT);
+    return cells[cell_index_at(x, y)];
+  }
+
+  // the nearest cell, for points on or off the grid
+  int cell_index_at(float x, float y) const {
     int ix = clamp((int)(x / GRID_CELL_WIDTH), 0, GRID_WIDTH - 1);
     int iy = clamp((int)(y / GRID_CELL_HEIGHT), 0, GRID_HEIGHT - 1);
-    return cell(ix, iy);
+    return iy*GRID_WIDTH + ix;
   }
-};
 
-struct Food {
-  float x, y;
-  float dx, dy;
-  float value;
+  void clear(int food_count) {
+    for(int c = 0; c < GRID_WIDTH * GRID_HEIGHT; c++) {
+      cells[c] = GridCellEmpty;
+      food_heads[c] = -1;
+    }
+    food_next.assign(food_count, -1);
+    food_prev.assign(food_count, -1);
+    food_cell.assign(food_count, -1);
+  }
+
+  // files food i under the cell at its position, if that has changed
+  void move_food(int i, const Foods &foods) {
+    int c = cell_index_at(foods.x[i], foods.y[i]);
+    if(c == food_cell[i]) {
+      return;
+    }
+    if(food_cell[i] >= 0) {
+      unlink_food(i);
+    }
+    food_cell[i] = c;
+    food_prev[i] = -1;
+    food_next[i] = food_heads[c];
+    if(food_heads[c] >= 0) {
+      food_prev[food_heads[c]] = i;
+    }
+    food_heads[c] = i;
+    cells[c] = GridCellFull;
+  }
+
+  // Searches rings of cells outwards from the one at (x, y). Every cell in
+  // ring r + 1 is at least r cells away, so once the best food is closer
+  // than that no later ring can beat it. Ties go to the lower index.
+  int nearest_food(const Foods &foods, float x, float y) const {
+    int c = cell_index_at(x, y);
+    int cx = c % GRID_WIDTH, cy = c / GRID_WIDTH;
+    const float cell_size = min(GRID_CELL_WIDTH, GRID_CELL_HEIGHT);
+    int nearest_index = -1;
+    float nearest_dist_sq = 0.0f;
+    for(int r = 0; r < max(GRID_WIDTH, GRID_HEIGHT); r++) {
+      for(int iy = max(cy - r, 0); iy <= min(cy + r, GRID_HEIGHT - 1); iy++) {
+        // only the ends of rows strictly inside the ring are on it
+        int step = (iy == cy - r || iy == cy + r) ? 1 : 2 * r;
+        for(int ix = cx - r; ix <= cx + r; ix += step) {
+          if(ix < 0 || ix >= GRID_WIDTH) {
+            continue;
+          }
+          for(int j = food_heads[iy*GRID_WIDTH + ix]; j >= 0; j = food_next[j]) {
+            float dx = foods.x[j] - x;
+            float dy = foods.y[j] - y;
+            float dist_sq = (dx*dx) + (dy*dy);
+            if(nearest_index < 0 || dist_sq < nearest_dist_sq || (dist_sq == nearest_dist_sq && j < nearest_index)) {
+              nearest_index = j;
+              nearest_dist_sq = dist_sq;
+            }
+          }
+        }
+      }
+      float reach = r * cell_size;
+      if(nearest_index >= 0 && nearest_dist_sq <= reach * reach) {
+        break;
+      }
+    }
+    return nearest_index;
+  }
+
+  // the lowest indexed food within radius of (x, y), or -1
+  int food_within(const Foods &foods, float x, float y, float radius) const {
+    int x0 = clamp((int)floorf((x - radius) / GRID_CELL_WIDTH), 0, GRID_WIDTH - 1);
+    int x1 = clamp((int)floorf((x + radius) / GRID_CELL_WIDTH), 0, GRID_WIDTH - 1);
+    int y0 = clamp((int)floorf((y - radius) / GRID_CELL_HEIGHT), 0, GRID_HEIGHT - 1);
+    int y1 = clamp((int)floorf((y + radius) / GRID_CELL_HEIGHT), 0, GRID_HEIGHT - 1);
+    int found = -1;
+    for(int iy = y0; iy <= y1; iy++) {
+      for(int ix = x0; ix <= x1; ix++) {
+        for(int j = food_heads[iy*GRID_WIDTH + ix]; j >= 0; j = food_next[j]) {
+          float dx = foods.x[j] - x;
+          float dy = foods.y[j] - y;
+          if((dx*dx) + (dy*dy) < radius*radius && (found < 0 || j < found)) {
+            found = j;
+          }
+        }
+      }
+    }
+    return found;
+  }
+
+private:
+  void unlink_food(int i) {
+    int c = food_cell[i];
+    if(food_prev[i] >= 0) {
+      food_next[food_prev[i]] = food_next[i];
+    } else {
+      food_heads[c] = food_next[i];
+    }
+    if(food_next[i] >= 0) {
+      food_prev[food_next[i]] = food_prev[i];
+    }
+    if(food_heads[c] < 0) {
+      cells[c] = GridCellEmpty;
+    }
+  }
 };
 
-Food make_food();
+void spawn_food(Foods &foods, int i);
 
 struct AgentInput {
   float nearest_food_relative_direction;
@@ -104,313 +259,479 @@ struct Agent {
   float orientation;
   float health;
   int score;
-  fann *ann;
 };
 
-void calculate_ann_input(AgentInput input, fann_type ann_input[ANN_NUM_INPUT]) {
+// every agent's network, agent i's at index i
+typedef MlpBatch<ANN_NUM_INPUT, ANN_NUM_HIDDEN, ANN_NUM_OUTPUT> Brains;
+static Brains brains(0);
+
+// the fourth input has no sensor behind it and reads 0
+void calculate_ann_input(AgentInput input, float ann_input[ANN_NUM_INPUT]) {
   ann_input[0] = input.nearest_food_relative_direction;
   ann_input[1] = input.nearest_food_distance;
   ann_input[2] = input.self_health;
+  ann_input[3] = 0.0f;
 }
 
-Agent make_agent() {
+Agent make_agent(int index) {
   Agent agent;
   // 1. agents start in a fixed location
   agent.x = WIDTH * 0.25f;
   agent.y = HEIGHT * 0.25f;
   // 2. -or- agents start in a random location
-//  agent.x = WIDTH * fdis(gen);
-//  agent.y = HEIGHT * fdis(gen);
+//  agent.x = WIDTH * rng.uniform();
+//  agent.y = HEIGHT * rng.uniform();
   agent.orientation = 0.0f;
-  agent.orientation = fdis(gen) * 2 * M_PI - M_PI;
+  agent.orientation = rng.uniform() * 2 * M_PI - M_PI;
   agent.health = MAX_HEALTH;
   agent.score = 0;
-  agent.ann = fann_create_standard(4, ANN_NUM_INPUT, ANN_NUM_HIDDEN, ANN_NUM_HIDDEN, ANN_NUM_OUTPUT);
-  fann_set_activation_function_hidden(agent.ann, FANN_SIGMOID_SYMMETRIC);
-  fann_set_activation_function_output(agent.ann, FANN_SIGMOID_SYMMETRIC);
-  fann_set_training_algorithm(agent.ann, FANN_TRAIN_INCREMENTAL);
-  fann_set_learning_rate(agent.ann, LEARNING_RATE);
-  fann_randomize_weights(agent.ann, -1.0f, 1.0f);
+  brains.randomize(index, rng, -1.0f, 1.0f);
   return agent;
 }
 
-void train_agent(Agent *agent, AgentInput input, AgentBehavior behavior) {
-  fann_type ann_input[ANN_NUM_INPUT];
-  calculate_ann_input(input, ann_input);
-
-  fann_type ann_output[ANN_NUM_OUTPUT] = {
-    behavior.rotational_force / AGENT_MAX_ROTATIONAL_FORCE,
-    behavior.force / AGENT_MAX_FORCE
-  };
-
-  fann_train(agent->ann, ann_input, ann_output);
+void print_ann(int index) {
+  brains.print(index);
 }
 
-AgentBehavior run_agent(Agent *agent, AgentInput input) {
-  fann_type ann_input[ANN_NUM_INPUT];
-  calculate_ann_input(input, ann_input);
-
-  fann_type *ann_output = fann_run(agent->ann, ann_input);
+// Live particles are packed at the front of the arrays: spawning appends,
+// and a dead particle's slot is filled from the end.
+struct Particles {
+  int count;
+  std::vector<float> life;
+  std::vector<float> x, y;
+  std::vector<float> vx, vy;
+  std::vector<float> r, g, b, a;
+
+  void reset(int capacity) {
+    count = 0;
+    life.resize(capacity);
+    x.resize(capacity);
+    y.resize(capacity);
+    vx.resize(capacity);
+    vy.resize(capacity);
+    r.resize(capacity);
+    g.resize(capacity);
+    b.resize(capacity);
+    a.resize(capacity);
+  }
 
-  AgentBehavior b = {
-    AGENT_MAX_ROTATIONAL_FORCE * ann_output[0],
-    AGENT_MAX_FORCE * ann_output[1]
-  };
-  return b;
-}
+  void spawn(float x, float y, float vx, float vy, float r, float g, float b, float a) {
+    if(count == (int)life.size()) {
+      return;
+    }
+    int i = count++;
+    this->life[i] = 1.0f;
+    this->x[i] = x;
+    this->y[i] = y;
+    this->vx[i] = vx;
+    this->vy[i] = vy;
+    this->r[i] = r;
+    this->g[i] = g;
+    this->b[i] = b;
+    this->a[i] = a;
+  }
 
-void print_ann(fann *ann) {
-  int num_conn = fann_get_total_connections(ann);
-  fann_connection connections[num_conn];
-  fann_get_connection_array(ann, connections);
-  for(int i = 0; i < num_conn; i++) {
-    printf("%d -> %d: %f\n",
-           connections[i].from_neuron,
-           connections[i].to_neuron,
-           connections[i].weight);
+  void kill(int i) {
+    int last = --count;
+    life[i] = life[last];
+    x[i] = x[last];
+    y[i] = y[last];
+    vx[i] = vx[last];
+    vy[i] = vy[last];
+    r[i] = r[last];
+    g[i] = g[last];
+    b[i] = b[last];
+    a[i] = a[last];
   }
-}
+};
 
-struct Particle {
-  float life;
+// Sounds and particles are side effects of the serial phase of a step,
+// queued there and played out once it is over.
+enum EventType {
+  EventPickup,
+  EventDeath
+};
+
+struct Event {
+  EventType type;
   float x, y;
-  float vx, vy;
-  float color[4];
 };
 
 static int frame = 0;
 static Grid grid;
-static Agent agents[NUM_AGENTS];
-static Food foods[FOOD_COUNT];
+static std::vector<Agent> agents;
+static Foods foods;
+static long meals = 0;
+static long deaths = 0;
+#ifndef BUDDIES_HEADLESS
 static bool quit = false;
 static EGSound *pickup_sound;
-static Particle particles[MAX_PARTICLES];
+static Particles particles;
+static float particle_damping;  // velocity kept per step
+#endif
+static Workers *workers;
+static std::vector<float> learning_rates;
+static std::vector<int> agent_meals;  // the food each agent reached this step, or -1
+static std::vector<int> food_eaten;   // the frame each food was last eaten
+static std::vector<Event> events;
+
+// name=value pairs from the command line; false if any is not understood
+bool read_settings(int argc, char *argv[]) {
+  for(int i = 1; i < argc; i++) {
+    char name[32];
+    int value;
+    if(sscanf(argv[i], "%31[^=]=%d", name, &value) != 2 || value < 1) {
+      return false;
+    }
+    if(strcmp(name, "agents") == 0) {
+      num_agents = value;
+    } else if(strcmp(name, "food") == 0) {
+      food_count = value;
+    } else if(strcmp(name, "particles") == 0) {
+      max_particles = value;
+    } else if(strcmp(name, "threads") == 0) {
+      num_threads = value;
+    } else if(strcmp(name, "seed") == 0) {
+      seed = value;
+#ifdef BUDDIES_HEADLESS
+    } else if(strcmp(name, "steps") == 0) {
+      steps = value;
+#endif
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
 
 void init() {
+#ifndef BUDDIES_HEADLESS
   eg_init(WIDTH, HEIGHT, "Buddies");
 
   pickup_sound = eg_load_sound("assets/pickup.wav");
 
-  for(int y = 0; y < GRID_HEIGHT; y++) {
-    for(int x = 0; x < GRID_WIDTH; x++) {
-      grid.cell(x, y) = GridCellEmpty;
+  particles.reset(max_particles);
+  particle_damping = powf(PARTICLE_VEL_DAMPING, DT);
+#endif
+
+  if(seed > 0) {
+    rng = Random((uint64_t)seed);
+    effects_rng = Random((uint64_t)seed << 32);
+  }
+
+  workers = new Workers(max(num_threads, 1));
+
+  grid.clear(food_count);
+
+  brains = Brains(num_agents);
+  agents.resize(num_agents);
+  for(int i = 0; i < num_agents; i++) {
+    agents[i] = make_agent(i);
+  }
+  learning_rates.assign(num_agents, LEARNING_RATE);
+  agent_meals.assign(num_agents, -1);
+
+  foods.resize(food_count);
+  food_eaten.assign(food_count, -1);
+  for(int i = 0; i < food_count; i++) {
+    spawn_food(foods, i);
+    grid.move_food(i, foods);
+  }
+}
+
+AgentInput perceive(const Agent &agent) {
+  AgentInput input;
+  int nearest_index = grid.nearest_food(foods, agent.x, agent.y);
+  float dx = foods.x[nearest_index] - agent.x;
+  float dy = foods.y[nearest_index] - agent.y;
+  input.nearest_food_relative_direction = angle_diff(atan2(dy, dx), agent.orientation);
+  input.nearest_food_distance = sqrtf(dx * dx + dy * dy);
+  input.self_health = agent.health;
+  return input;
+}
+
+// The parallel phase of a step for agents [begin, end): learning from the
+// leader, perception, thinking, movement and health. Each agent reads only
+// itself and the food, which nothing changes until the serial phase, and
+// writes only itself, so ranges can run on different threads.
+void update_agents(int begin, int end, int leader, const float *leader_input, const float *leader_output) {
+  for(int i = begin; i < end; i++) {
+    learning_rates[i] = i == leader ? 0.0f : LEARNING_RATE; // don't train the leader
+  }
+  brains.train(leader_input, leader_output, learning_rates.data(), begin, end);
+
+  // then every agent acts on what it sees
+  for(int i = begin; i < end; i++) {
+    float ann_input[ANN_NUM_INPUT];
+    calculate_ann_input(perceive(agents[i]), ann_input);
+    for(int k = 0; k < ANN_NUM_INPUT; k++) {
+      brains.input(k)[i] = ann_input[k];
     }
   }
+  brains.run(begin, end);
 
-  for(int i = 0; i < NUM_AGENTS; i++) {
-    agents[i] = make_agent();
+  for(int i = begin; i < end; i++) {
+    AgentBehavior behavior;
+    behavior.rotational_force = AGENT_MAX_ROTATIONAL_FORCE * brains.output(0)[i];
+    behavior.force = AGENT_MAX_FORCE * brains.output(1)[i];
+
+    agents[i].orientation = angle_diff(agents[i].orientation + behavior.rotational_force, 0.0f);
+    agents[i].x = agents[i].x + DT * behavior.force * (float)cos(agents[i].orientation);
+    agents[i].y = agents[i].y + DT * behavior.force * (float)sin(agents[i].orientation);
+
+    // decay health as a function of force and time
+    float new_health = agents[i].health - ((DT * HEALTH_DECAY * abs(behavior.force)) + HEALTH_DECAY_CONSTANT);
+    agents[i].health = max(0.0f, new_health);
+
+    agent_meals[i] = grid.food_within(foods, agents[i].x, agents[i].y, EAT_DISTANCE);
   }
+}
+
+// The serial phase of a step: agents eat and die in index order, so the
+// first agent to reach a food gets it.
+void resolve_agents() {
+  for(int i = 0; i < num_agents; i++) {
+    int j = agent_meals[i];
+    if(j >= 0 && food_eaten[j] != frame) {
+      agents[i].health = min(MAX_HEALTH, agents[i].health + FOOD_VALUE * foods.value[j]);
+      agents[i].score++;
+      meals++;
+      food_eaten[j] = frame;
+      spawn_food(foods, j);
+      grid.move_food(j, foods);
+      events.push_back(Event { EventPickup, agents[i].x, agents[i].y });
+    }
 
-  for(int i = 0; i < FOOD_COUNT; i++) {
-    foods[i] = make_food();
+    // death
+    if(agents[i].health <= 0.0f) {
+      events.push_back(Event { EventDeath, agents[i].x, agents[i].y });
+      deaths++;
+      agents[i] = make_agent(i);
+    }
   }
+}
 
-  for(int i = 0; i < MAX_PARTICLES; i++) {
-    particles[i].life = 0.0f;
+// one pickup sound a step however many agents ate
+void play_events() {
+#ifndef BUDDIES_HEADLESS
+  bool pickup = false;
+  for(size_t e = 0; e < events.size(); e++) {
+    if(events[e].type == EventPickup) {
+      pickup = true;
+    } else if(events[e].type == EventDeath) {
+      for(int n = 0; n < DEATH_PARTICLES; n++) {
+        float speed = 10.0f + effects_rng.uniform() * 50.0f;
+        float angle = effects_rng.uniform() * 2 * PI;
+        particles.spawn(events[e].x, events[e].y, speed * cosf(angle), speed * sinf(angle), 1.0f, 0.0f, 0.0f, 1.0f);
+      }
+    }
   }
+  if(pickup) {
+    eg_play_sound(pickup_sound);
+  }
+#endif
+  events.clear();
 }
 
+#ifndef BUDDIES_HEADLESS
+void draw(int high_score_index);
+#endif
+
 void step() {
+#ifndef BUDDIES_HEADLESS
   EGEvent event;
   while(eg_poll_event(&event)) {
     if(event.type == SDL_QUIT) {
       quit = true;
     }
   }
+#endif
 
   // food model
-  for(int i = 0; i < FOOD_COUNT; i++) {
-    foods[i].x += foods[i].dx;
-    foods[i].y += foods[i].dy;
-    if (foods[i].x < 0.0f || foods[i].x > WIDTH || foods[i].y < 0.0f || foods[i].y > HEIGHT) {
-      foods[i] = make_food();
-    }
+  for(int i = 0; i < food_count; i++) {
+    foods.x[i] += foods.dx[i];
+    foods.y[i] += foods.dy[i];
   }
-
-  // agent model
-  AgentInput agent_inputs[NUM_AGENTS];
-  for(int i = 0; i < NUM_AGENTS; i++) {
-    int nearest_index;
-    float nearest_dist_sq;
-    for(int j = 0; j < FOOD_COUNT; j++) {
-      float dx = foods[j].x - agents[i].x;
-      float dy = foods[j].y - agents[i].y;
-      float dist_sq = (dx*dx) + (dy*dy);
-      if(j == 0 || dist_sq < nearest_dist_sq) {
-        nearest_index = j;
-        nearest_dist_sq = dist_sq;
-      }
+  for(int i = 0; i < food_count; i++) {
+    if (foods.x[i] < 0.0f || foods.x[i] > WIDTH || foods.y[i] < 0.0f || foods.y[i] > HEIGHT) {
+      spawn_food(foods, i);
     }
-    float dx = foods[nearest_index].x - agents[i].x;
-    float dy = foods[nearest_index].y - agents[i].y;
-    agent_inputs[i].nearest_food_relative_direction = angle_diff(atan2(dy, dx), agents[i].orientation);
-    agent_inputs[i].nearest_food_distance = sqrtf(dx * dx + dy * dy);
-    agent_inputs[i].self_health = agents[i].health;
+    grid.move_food(i, foods);
   }
 
   // index of high scoring agent
   int high_score_index = 0;
-  for(int i = 1; i < NUM_AGENTS; i++) {
+  for(int i = 1; i < num_agents; i++) {
     if(agents[i].score > agents[high_score_index].score) {
       high_score_index = i;
     }
   }
 
-  AgentBehavior agent_behaviors[NUM_AGENTS];
-
-  for(int i = 0; i < NUM_AGENTS; i++) {
-
-    //
-    //
-    if (i != high_score_index) { // don't train the leader
-      train_agent(&agents[i], agent_inputs[high_score_index], agent_behaviors[high_score_index]);
+  // the leader acts first, and everyone else learns to do what it did
+  float leader_input[ANN_NUM_INPUT], leader_output[ANN_NUM_OUTPUT];
+  calculate_ann_input(perceive(agents[high_score_index]), leader_input);
+  brains.run_one(high_score_index, leader_input, leader_output);
+
+  // agent model; ranges are multiples of 16 agents so that no two threads
+  // write the same cache line of the networks
+  workers->parallel_for(num_agents, 16, [&](int begin, int end) {
+    update_agents(begin, end, high_score_index, leader_input, leader_output);
+  });
+  resolve_agents();
+  play_events();
+
+#ifndef BUDDIES_HEADLESS
+  for(int i = 0; i < particles.count; i++) {
+    particles.life[i] -= DT;
+    particles.x[i] += DT * particles.vx[i];
+    particles.y[i] += DT * particles.vy[i];
+    particles.vx[i] *= particle_damping;
+    particles.vy[i] *= particle_damping;
+  }
+  for(int i = particles.count - 1; i >= 0; i--) {
+    if(particles.life[i] <= 0.0f) {
+      particles.kill(i);
     }
+  }
 
-    //
-    //
-    agent_behaviors[i] = run_agent(&agents[i], agent_inputs[i]);
-
-    agents[i].orientation = angle_diff(agents[i].orientation + agent_behaviors[i].rotational_force, 0.0f);
-    agents[i].x = agents[i].x + DT * agent_behaviors[i].force * (float)cos(agents[i].orientation);
-    agents[i].y = agents[i].y + DT * agent_behaviors[i].force * (float)sin(agents[i].orientation);
+  bool skip_render = eg_get_keystate(SDL_SCANCODE_F) && (frame % TURBO_RATE != 0);
+  if(!skip_render) {
+    draw(high_score_index);
+  }
+#endif
 
-    // decay health as a function of force and time
-    float new_health = agents[i].health - ((DT * HEALTH_DECAY * abs(agent_behaviors[i].force)) + HEALTH_DECAY_CONSTANT);
-    agents[i].health = max(0.0f, new_health);
+  frame++;
+}
 
-    for(int j = 0; j < FOOD_COUNT; j++) {
-       float dx = foods[j].x - agents[i].x;
-       float dy = foods[j].y - agents[i].y;
-       float dist_sq = (dx*dx) + (dy*dy);
-       if(dist_sq < EAT_DISTANCE*EAT_DISTANCE) {
-         agents[i].health = min(MAX_HEALTH, agents[i].health + FOOD_VALUE * foods[j].value);
-         agents[i].score++;
-         foods[j] = make_food();
-         eg_play_sound(pickup_sound);
-         break;
-       }
+#ifndef BUDDIES_HEADLESS
+void draw(int high_score_index) {
+  eg_clear_screen(0.0f, 0.0f, 0.0f, 0.0f);
+
+  // draw grid
+  eg_set_color(0.5f, 0.5f, 0.5f, 0.5f);
+  for(int x = 0; x < GRID_WIDTH; x++) {
+    float fx = x / (float)GRID_WIDTH * WIDTH;
+    eg_draw_line(fx, 0.0f, fx, HEIGHT);
+    if (x % 7 == 0) {
+      eg_set_color(1.0f, 1.0f, 1.0f, 0.3f);
+      eg_draw_line(fx, 0.0f, fx, HEIGHT);
+      eg_set_color(0.5f, 0.5f, 0.5f, 0.5f);
     }
-
-    // death
-    if(agents[i].health <= 0.0f) {
-      for(int j = 0, n = 100; j < MAX_PARTICLES && n > 0; j++) {
-        if(particles[j].life <= 0.0f) {
-          particles[j].life = 1.0f;
-          particles[j].x = agents[i].x;
-          particles[j].y = agents[i].y;
-          float speed = 10.0f + fdis(gen) * 50.0f;
-          float angle = fdis(gen) * 2 * PI;
-          particles[j].vx = speed * cosf(angle);
-          particles[j].vy = speed * sinf(angle);
-          particles[j].color[0] = 1.0f;
-          particles[j].color[1] = 0.0f;
-          particles[j].color[2] = 0.0f;
-          particles[j].color[3] = 1.0f;
-          n--;
-        }
-      }
-      agents[i] = make_agent();
+  }
+  for(int y = 0; y < GRID_HEIGHT; y++) {
+    float fy = y / (float)GRID_WIDTH * WIDTH;
+    eg_draw_line(0.0f, fy, WIDTH, fy);
+    if (y % 7 == 0) {
+      eg_set_color(1.0f, 1.0f, 1.0f, 0.3f);
+      eg_set_color(0.5f, 0.5f, 0.5f, 0.5f);
     }
   }
 
-  for(int i = 0; i < MAX_PARTICLES; i++) {
-    if(particles[i].life > 0.0f) {
-      particles[i].life -= DT;
+  // draw agents
+  for(int i = 0; i < num_agents; i++) {
+
+    // indicate orientation
+    eg_set_color(0.9f, 0.9f, 0.9f, 1.0f);
+    eg_draw_line(agents[i].x,
+                 agents[i].y,
+                 agents[i].x + (float)cos(agents[i].orientation) * 10.0F,
+                 agents[i].y + (float)sin(agents[i].orientation) * 10.0F,
+                 10);
+
+    // agent
+    eg_set_color(0.9f, 0.9f, 0.9f, 1.0f);
+    eg_draw_square(agents[i].x - 0.5f*BUDDY_SIZE, agents[i].y - 0.5f*BUDDY_SIZE, BUDDY_SIZE, BUDDY_SIZE);
+    eg_set_color(0.0f, 0.0f, 0.0f, 1.0f);
+    eg_draw_square(agents[i].x - 0.5f*BUDDY_SIZE*0.5f, agents[i].y - 0.5f*BUDDY_SIZE*0.5f, BUDDY_SIZE*0.5f, BUDDY_SIZE*0.5f);
+
+    // health bar
+    eg_set_color(0.2f, 0.2f, 0.2f, 0.7f);
+    eg_draw_square(agents[i].x - 15.0f, agents[i].y + 12.0f, 30.0f, 5.0f);
+    if (agents[i].health > MAX_HEALTH * 0.25f) {
+      eg_set_color(0.5f, 0.9f, 0.5f, 0.8f);
+    } else {
+      eg_set_color(0.8f, 0.3f, 0.3f, 0.8f);
     }
-    particles[i].x += DT * particles[i].vx;
-    particles[i].y += DT * particles[i].vy;
-    particles[i].vx *= powf(PARTICLE_VEL_DAMPING, DT);
-    particles[i].vy *= powf(PARTICLE_VEL_DAMPING, DT);
-  }
+    eg_draw_square(agents[i].x - 15.0f, agents[i].y + 12.0f, agents[i].health * 30.0f / MAX_HEALTH, 5.0f);
 
-  bool skip_render = eg_get_keystate(SDL_SCANCODE_F) && (frame % TURBO_RATE != 0);
-  if(!skip_render) {
-    eg_clear_screen(0.0f, 0.0f, 0.0f, 0.0f);
+    // score bar
+    eg_set_color(0.2f, 0.2f, 0.2f, 0.7f);
+    eg_draw_square(agents[i].x - 15.0f, agents[i].y + 20.0f, 30.0f, 5.0f);
+    eg_set_color(0.9f, 0.85f, 0.0f, 0.8f);
+    eg_draw_square(agents[i].x - 15.0f, agents[i].y + 20.0f, 30.0f * ((float)agents[i].score / (float)agents[high_score_index].score), 5.0f);
+  }
 
-    // draw grid
-    eg_set_color(0.5f, 0.5f, 0.5f, 0.5f);
-    for(int x = 0; x < GRID_WIDTH; x++) {
-      float fx = x / (float)GRID_WIDTH * WIDTH;
-      eg_draw_line(fx, 0.0f, fx, HEIGHT);
-      if (x % 7 == 0) {
-        eg_set_color(1.0f, 1.0f, 1.0f, 0.3f);
-        eg_draw_line(fx, 0.0f, fx, HEIGHT);
-        eg_set_color(0.5f, 0.5f, 0.5f, 0.5f);
-      }
-    }
-    for(int y = 0; y < GRID_HEIGHT; y++) {
-      float fy = y / (float)GRID_WIDTH * WIDTH;
-      eg_draw_line(0.0f, fy, WIDTH, fy);
-      if (y % 7 == 0) {
-        eg_set_color(1.0f, 1.0f, 1.0f, 0.3f);
-        eg_set_color(0.5f, 0.5f, 0.5f, 0.5f);
-      }
-    }
+  // draw foods
+  for(int i = 0; i < food_count; i++) {
+    eg_set_color(0.0f, 0.8f, 0.0f, 1.0f - 0.5f * foods.value[i]);
+    eg_draw_square(foods.x[i] - 0.5f*FOOD_SIZE, foods.y[i] - 0.5f*FOOD_SIZE, FOOD_SIZE, FOOD_SIZE);
+  }
 
-    // draw agents
-    for(int i = 0; i < NUM_AGENTS; i++) {
-
-      // indicate orientation
-      eg_set_color(0.9f, 0.9f, 0.9f, 1.0f);
-      eg_draw_line(agents[i].x,
-                   agents[i].y,
-                   agents[i].x + (float)cos(agents[i].orientation) * 10.0F,
-                   agents[i].y + (float)sin(agents[i].orientation) * 10.0F,
-                   10);
-
-      // agent
-      eg_set_color(0.9f, 0.9f, 0.9f, 1.0f);
-      eg_draw_square(agents[i].x - 0.5f*BUDDY_SIZE, agents[i].y - 0.5f*BUDDY_SIZE, BUDDY_SIZE, BUDDY_SIZE);
-      eg_set_color(0.0f, 0.0f, 0.0f, 1.0f);
-      eg_draw_square(agents[i].x - 0.5f*BUDDY_SIZE*0.5f, agents[i].y - 0.5f*BUDDY_SIZE*0.5f, BUDDY_SIZE*0.5f, BUDDY_SIZE*0.5f);
-
-      // health bar
-      eg_set_color(0.2f, 0.2f, 0.2f, 0.7f);
-      eg_draw_square(agents[i].x - 15.0f, agents[i].y + 12.0f, 30.0f, 5.0f);
-      if (agents[i].health > MAX_HEALTH * 0.25f) {
-        eg_set_color(0.5f, 0.9f, 0.5f, 0.8f);
-      } else {
-        eg_set_color(0.8f, 0.3f, 0.3f, 0.8f);
-      }
-      eg_draw_square(agents[i].x - 15.0f, agents[i].y + 12.0f, agents[i].health * 30.0f / MAX_HEALTH, 5.0f);
+  // high score
+  eg_set_color(0.9f, 0.3f, 0.3f, 1.0f);
+  eg_draw_square(agents[high_score_index].x - 0.5f*BUDDY_SIZE, agents[high_score_index].y - 0.5f*BUDDY_SIZE, BUDDY_SIZE, BUDDY_SIZE);
 
-      // score bar
-      eg_set_color(0.2f, 0.2f, 0.2f, 0.7f);
-      eg_draw_square(agents[i].x - 15.0f, agents[i].y + 20.0f, 30.0f, 5.0f);
-      eg_set_color(0.9f, 0.85f, 0.0f, 0.8f);
-      eg_draw_square(agents[i].x - 15.0f, agents[i].y + 20.0f, 30.0f * ((float)agents[i].score / (float)agents[high_score_index].score), 5.0f);
-    }
+  // draw particles
+  for(int i = 0; i < particles.count; i++) {
+    eg_set_color(particles.r[i], particles.g[i], particles.b[i], particles.a[i]);
+    eg_draw_point(particles.x[i], particles.y[i], 5.0f);
+  }
 
-    // draw foods
-    for(int i = 0; i < FOOD_COUNT; i++) {
-      eg_set_color(0.0f, 0.8f, 0.0f, 1.0f - 0.5f * foods[i].value);
-      eg_draw_square(foods[i].x - 0.5f*FOOD_SIZE, foods[i].y - 0.5f*FOOD_SIZE, FOOD_SIZE, FOOD_SIZE);
-    }
+  eg_swap_buffers();
+}
+#endif
 
-    // high score
-    eg_set_color(0.9f, 0.3f, 0.3f, 1.0f);
-    eg_draw_square(agents[high_score_index].x - 0.5f*BUDDY_SIZE, agents[high_score_index].y - 0.5f*BUDDY_SIZE, BUDDY_SIZE, BUDDY_SIZE);
 
-    // draw particles
-    for(int i = 0; i < MAX_PARTICLES; i++) {
-      if(particles[i].life > 0.0f) {
-        eg_set_color(particles[i].color[0], particles[i].color[1], particles[i].color[2], particles[i].color[3]);
-        eg_draw_point(particles[i].x, particles[i].y, 5.0f);
-      }
-    }
+#ifdef BUDDIES_HEADLESS
+// the mean, the extremes and the deciles between of one value of the agents
+void print_distribution(const char *name, std::vector<float> &values) {
+  std::sort(values.begin(), values.end());
+  double sum = 0.0;
+  for(size_t i = 0; i < values.size(); i++) {
+    sum += values[i];
+  }
+  int last = (int)values.size() - 1;
+  printf("%s_mean=%.2f\n%s_min=%.2f\n%s_p10=%.2f\n%s_p50=%.2f\n%s_p90=%.2f\n%s_max=%.2f\n",
+         name, sum / values.size(), name, values[0], name, values[last / 10],
+         name, values[last / 2], name, values[last * 9 / 10], name, values[last]);
+}
 
-    eg_swap_buffers();
+// how fast the run went, and how its agents stand at the end of it
+void report(double seconds) {
+  std::vector<float> scores(num_agents), healths(num_agents);
+  for(int i = 0; i < num_agents; i++) {
+    scores[i] = (float)agents[i].score;
+    healths[i] = agents[i].health;
   }
-  
-  frame++;
+  printf("steps=%d\nagents=%d\nthreads=%d\nseed=%d\nseconds=%.2f\nsteps_per_second=%.0f\nagent_steps_per_second=%.0f\n",
+         frame, num_agents, workers->size(), seed, seconds,
+         frame / max(seconds, 1e-6), (double)frame * num_agents / max(seconds, 1e-6));
+  printf("meals=%ld\ndeaths=%ld\n", meals, deaths);
+  print_distribution("score", scores);
+  print_distribution("health", healths);
 }
+#endif
 
 int main(int argc, char *argv[]) {
-  assert(NUM_AGENTS >= 1);
+  if(!read_settings(argc, argv)) {
+#ifdef BUDDIES_HEADLESS
+    printf("usage: buddies [agents=N] [food=N] [threads=N] [steps=100000] [seed=1]\n");
+#else
+    printf("usage: buddies [agents=N] [food=N] [particles=N] [threads=N] [seed=N]\n");
+#endif
+    return 1;
+  }
 
   init();
 
-#ifdef __EMSCRIPTEN__
+#ifdef BUDDIES_HEADLESS
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int i = 0; i < steps; i++) {
+    step();
+  }
+  double seconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1e6;
+  report(seconds);
+#elif defined(__EMSCRIPTEN__)
   emscripten_set_main_loop(step, 0, 1);
 #else
   while(!quit) {
@@ -418,26 +739,22 @@ int main(int argc, char *argv[]) {
   }
 #endif
 
+#ifndef BUDDIES_HEADLESS
   eg_shutdown();
+#endif
+  delete workers;
 
   return 0;
 }
 
-Food make_food() {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<float> fdis(0, 1);
-  float x = WIDTH * fdis(gen);
-  float y = HEIGHT * fdis(gen);
-  float dx = FLOW_DX * 0.5f + x / WIDTH * FLOW_DX * 0.5f;
-  float dy = FLOW_DY * 0.5f + x / HEIGHT * FLOW_DY;
-  float value = x / WIDTH;
-  Food f = {
-    x, y,
-    dx, dy,
-    value
-  };
-  return f;
+void spawn_food(Foods &foods, int i) {
+  float x = WIDTH * rng.uniform();
+  float y = HEIGHT * rng.uniform();
+  foods.x[i] = x;
+  foods.y[i] = y;
+  foods.dx[i] = FLOW_DX * 0.5f + x / WIDTH * FLOW_DX * 0.5f;
+  foods.dy[i] = FLOW_DY * 0.5f + x / HEIGHT * FLOW_DY;
+  foods.value[i] = x / WIDTH;
 }
 
 float angle_diff(float a, float b) {
@@ -128,6 +128,7 @@ void eg_draw_square(float x, float y, float w, float h) {
 
 struct EGImage {
   GLuint tex;
+  int w, h;
 };
 
 EGImage *eg_load_image(const std::string &filename) {
@@ -140,12 +141,50 @@ EGImage *eg_load_image(const std::string &filename) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+  EGImage *image = new EGImage { texture, surface->w, surface->h };
+
   SDL_FreeSurface(surface);
 
-  EGImage *image = new EGImage { texture };
   return image;
 }
 
+EGImage *eg_create_image(int w, int h) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  EGImage *image = new EGImage { texture, w, h };
+  return image;
+}
+
+void eg_update_image(EGImage *img, const unsigned char *rgba) {
+  glBindTexture(GL_TEXTURE_2D, img->tex);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, img->w, img->h, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void eg_draw_image_corners(EGImage *img, float x0, float y0, float x1, float y1,
+                           float x2, float y2, float x3, float y3) {
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, img->tex);
+
+  glBegin(GL_QUADS);
+    glTexCoord2f(0, 0); glVertex2f(x0, y0);
+    glTexCoord2f(1, 0); glVertex2f(x1, y1);
+    glTexCoord2f(1, 1); glVertex2f(x2, y2);
+    glTexCoord2f(0, 1); glVertex2f(x3, y3);
+  glEnd();
+
+  glDisable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void eg_free_image(EGImage *image) {
   glDeleteTextures(1, &image->tex);
   delete image;
@@ -33,6 +33,14 @@ struct EGImage;
 EGImage *eg_load_image(const std::string &filename);
 void eg_free_image(EGImage *image);
 void eg_draw_image(EGImage *img, float x, float y, float w, float h);
+// an image to draw into: w by h texels, filtered smoothly when scaled
+EGImage *eg_create_image(int w, int h);
+// replaces every texel, w * h of them in RGBA bytes, from the first row
+void eg_update_image(EGImage *img, const unsigned char *rgba);
+// the image stretched over any four corners: the start and end of its first
+// row, then the end and start of its last
+void eg_draw_image_corners(EGImage *img, float x0, float y0, float x1, float y1,
+                           float x2, float y2, float x3, float y3);
 
 // util
 template<typename T>
@@ -0,0 +1,234 @@
+//
+// Patterns of Life genome evaluation, headless
+//
+//   ./evaluate [name=value ...]
+//
+//   genomes     a genome bank to judge every genome of, such as the one a
+//               run appends to; without one, random genomes are judged
+//   count       random genomes to judge without a file (16)
+//   worlds      micro-worlds per genome (64)
+//   frames      frames per world (2000)
+//   size        hexes across each world (10)
+//   agents      agents per world (8)
+//   copies      agents per world carrying the genome on trial (1)
+//   rivals      "random" genomes, or the rest of the "batch" (random)
+//   activation  "exact", "rational" or "table" (table)
+//   threads     (every core)
+//   seed        (1)
+//
+// Every genome is scored in the same seeded worlds: genome g in world w
+// always meets the same rivals and the same food, however many threads.
+// Genomes are listed best first by mean meals, with the variance of meals
+// and of frames survived. Agents are wired with the senses the bank records
+// its genomes were evolved under, and random genomes with the standard ones.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Brain.h"
+#include "GenomeBank.h"
+#include "MicroWorld.h"
+#include "Workers.h"
+
+using namespace std::chrono;
+
+static std::string genomes_path;
+static int count = 16;
+static int worlds = 64;
+static int frames = 2000;
+static int size = 10;
+static int agents = 8;
+static int copies = 1;
+static std::string rivals = "random";
+static std::string activation = "table";
+static int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+static int seed = 1;
+
+bool read_settings(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    char name[32], value[256];
+    if (sscanf(argv[i], "%31[^=]=%255s", name, value) != 2) {
+      return false;
+    }
+    int number = atoi(value);
+    if (strcmp(name, "genomes") == 0) {
+      genomes_path = value;
+    } else if (strcmp(name, "rivals") == 0) {
+      rivals = value;
+    } else if (strcmp(name, "activation") == 0) {
+      activation = value;
+    } else if (number < 1) {
+      return false;
+    } else if (strcmp(name, "count") == 0) {
+      count = number;
+    } else if (strcmp(name, "worlds") == 0) {
+      worlds = number;
+    } else if (strcmp(name, "frames") == 0) {
+      frames = number;
+    } else if (strcmp(name, "size") == 0) {
+      size = number;
+    } else if (strcmp(name, "agents") == 0) {
+      agents = number;
+    } else if (strcmp(name, "copies") == 0) {
+      copies = number;
+    } else if (strcmp(name, "threads") == 0) {
+      threads = number;
+    } else if (strcmp(name, "seed") == 0) {
+      seed = number;
+    } else {
+      return false;
+    }
+  }
+  return activation_named(activation) >= 0 && (rivals == "random" || rivals == "batch") &&
+         copies <= agents && agents <= size * size;
+}
+
+struct Score {
+  int genome;
+  double meals, meals_variance;
+  double survival, survival_variance;
+};
+
+int main(int argc, char *argv[]) {
+  if (!read_settings(argc, argv)) {
+    printf("usage: evaluate [genomes=<file>] [count=16] [worlds=64] [frames=2000] [size=10] [agents=8] [copies=1]\n"
+           "                [rivals=random|batch] [activation=exact|rational|table] [threads=n] [seed=1]\n");
+    return 1;
+  }
+  Parameters parameters = default_parameters();
+  Senses senses = Senses::standard();
+  Random rng(seed);
+
+  std::vector<AgentGenome> genomes;
+  std::vector<float> hues;
+  BankReader bank;
+  if (!genomes_path.empty()) {
+    if (!bank.open(genomes_path)) {
+      return 1;
+    }
+    // worlds are wired as the bank's genomes were evolved
+    if (!bank.layout(senses)) {
+      printf("%s does not say how its genomes were wired\n", genomes_path.c_str());
+      return 1;
+    }
+    genomes.resize(bank.size());
+    for (int g = 0; g < bank.size(); g++) {
+      genomes[g].assign(bank[g].genes);
+      hues.push_back(bank[g].hue);
+    }
+  } else {
+    genomes.resize(count);
+    for (int g = 0; g < count; g++) {
+      float genes[DNA_SIZE];
+      rng.normals(genes, DNA_SIZE);
+      for (int i = 0; i < DNA_SIZE; i++) {
+        genes[i] *= parameters.dna_multiplier;
+      }
+      genomes[g].assign(genes);
+      hues.push_back(rng.uniform());
+    }
+  }
+  int genome_count = (int)genomes.size();
+  if (genome_count == 0 || (rivals == "batch" && genome_count < 2)) {
+    printf("not enough genomes to judge\n");
+    return 1;
+  }
+
+  MicroWorld::Settings settings = { size, size, agents, copies, frames, parameters, senses };
+  int jobs = genome_count * worlds;
+  std::vector<MicroOutcome> outcomes((size_t)jobs * copies);
+  std::vector<long> steps(jobs);
+  int tier = activation_named(activation);
+
+  Workers workers(threads);
+  steady_clock::time_point start = steady_clock::now();
+  workers.parallel_for(jobs, 1, [&](int begin, int end) {
+    MicroWorld world(settings);
+    std::vector<AgentGenome> random_rivals(agents);
+    std::vector<const AgentGenome *> lineup(agents - copies + 1);
+    std::vector<float> lineup_hues(lineup.size());
+    std::vector<MicroOutcome> out;
+    for (int job = begin; job < end; job++) {
+      int g = job / worlds, w = job % worlds;
+      // the same world for every genome: its rivals and food depend on w alone
+      Random world_rng((uint64_t)seed << 32 | (uint32_t)w);
+      lineup[0] = &genomes[g];
+      lineup_hues[0] = hues[g];
+      for (int a = 1; a < (int)lineup.size(); a++) {
+        if (rivals == "batch") {
+          int rival = (int)(world_rng.uniform() * (genome_count - 1));
+          rival = rival >= g ? rival + 1 : rival;
+          lineup[a] = &genomes[rival];
+          lineup_hues[a] = hues[rival];
+        } else {
+          float genes[DNA_SIZE];
+          world_rng.normals(genes, DNA_SIZE);
+          for (int i = 0; i < DNA_SIZE; i++) {
+            genes[i] *= parameters.dna_multiplier;
+          }
+          random_rivals[a].assign(genes);
+          lineup[a] = &random_rivals[a];
+          // spread out, without a draw that would change the world
+          lineup_hues[a] = (float)a / lineup.size();
+        }
+      }
+      out.clear();
+      switch (tier) {
+      case ACTIVATION_RATIONAL:
+        world.run<TanhRational>(lineup.data(), lineup_hues.data(), world_rng, out);
+        break;
+      case ACTIVATION_TABLE:
+        world.run<TanhTable>(lineup.data(), lineup_hues.data(), world_rng, out);
+        break;
+      default:
+        world.run<TanhExact>(lineup.data(), lineup_hues.data(), world_rng, out);
+        break;
+      }
+      std::copy(out.begin(), out.end(), outcomes.begin() + (size_t)job * copies);
+      steps[job] = world.agent_steps();
+    }
+  });
+  double seconds = duration_cast<microseconds>(steady_clock::now() - start).count() / 1e6;
+
+  std::vector<Score> scores(genome_count);
+  for (int g = 0; g < genome_count; g++) {
+    Score &score = scores[g];
+    score.genome = g;
+    const MicroOutcome *o = &outcomes[(size_t)g * worlds * copies];
+    int n = worlds * copies;
+    double meals = 0.0, meals2 = 0.0, survival = 0.0, survival2 = 0.0;
+    for (int i = 0; i < n; i++) {
+      meals += o[i].meals;
+      meals2 += (double)o[i].meals * o[i].meals;
+      survival += o[i].survival;
+      survival2 += (double)o[i].survival * o[i].survival;
+    }
+    score.meals = meals / n;
+    score.meals_variance = meals2 / n - score.meals * score.meals;
+    score.survival = survival / n;
+    score.survival_variance = survival2 / n - score.survival * score.survival;
+  }
+  std::stable_sort(scores.begin(), scores.end(), [](const Score &a, const Score &b) {
+    return a.meals > b.meals;
+  });
+
+  long total_steps = 0;
+  for (int j = 0; j < jobs; j++) {
+    total_steps += steps[j];
+  }
+  for (int s = 0; s < genome_count; s++) {
+    const Score &score = scores[s];
+    printf("genome=%d hue=%.2f meals=%.2f meals_variance=%.2f survival=%.0f survival_variance=%.0f\n",
+           score.genome, hues[score.genome], score.meals, score.meals_variance,
+           score.survival, score.survival_variance);
+  }
+  printf("genomes=%d\nworlds=%d\nthreads=%d\nagent_steps=%ld\nseconds=%.2f\nagent_steps_per_second=%.0f\n",
+         genome_count, jobs, workers.size(), total_steps, seconds, total_steps / std::max(seconds, 1e-6));
+  return 0;
+}
@@ -0,0 +1,121 @@
+//
+// Patterns of Life monitor: attaches to a running sim and prints what it is
+// doing, without the sim doing any work for it.
+//
+//   ./monitor <pid>        everything, once
+//   ./monitor -f <pid>     one line a second until the sim exits
+//
+// The segment's name, /patterns-<pid>, can be given instead of the pid.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include "Activation.h"
+#include "Monitor.h"
+
+using std::string;
+
+void print_all(const MonitorData &d) {
+  const StatsSnapshot &s = d.stats;
+  const Parameters &p = d.parameters;
+  printf("frame=%d\n", d.frame);
+  printf("live=%d\n", s.live);
+  printf("species=%d\n", d.species);
+  printf("genomes=%d\n", d.distinct_genomes);
+  printf("island=%d/%d\n", d.island, d.islands);
+  printf("emigrants=%llu\nimmigrants=%llu\n", (unsigned long long)d.emigrants, (unsigned long long)d.immigrants);
+  printf("births=%llu\n", (unsigned long long)s.births);
+  printf("starved=%llu\n", (unsigned long long)s.deaths[DEATH_STARVATION]);
+  printf("killed=%llu\n", (unsigned long long)s.deaths[DEATH_KILLED]);
+  printf("meals=%llu\n", (unsigned long long)s.meals);
+  printf("moves=%llu/%llu\n", (unsigned long long)s.moves, (unsigned long long)s.moves_attempted);
+  printf("spawns=%llu/%llu\n", (unsigned long long)s.spawns, (unsigned long long)s.spawns_attempted);
+  printf("mean_age=%.1f\nmax_age=%d\n", s.mean_age, s.max_age);
+  printf("mean_score=%.2f\nmax_score=%d\n", s.mean_score, s.max_score);
+  for (int i = 0; i < PHASES; i++) {
+    printf("%s_ns=%.0f\n", PHASE_NAMES[i], d.frame > 0 ? (double)d.phase_ns[i] / d.frame : 0.0);
+  }
+  printf("num_agents=%d\n", p.num_agents);
+  printf("agent_spawn_rate=%g\n", p.agent_spawn_rate);
+  printf("food_spawn_rate=%g\n", p.food_spawn_rate);
+  printf("food_value=%g\n", p.food_value);
+  printf("max_hp=%g\n", p.max_hp);
+  printf("burn_rate=%g\n", p.burn_rate);
+  printf("mutate_rate=%g\n", p.mutate_rate);
+  printf("mutate_amount=%g\n", p.mutate_amount);
+  printf("dna_multiplier=%g\n", p.dna_multiplier);
+  printf("rotational_waiting=%d\n", p.rotational_waiting);
+  printf("linear_waiting=%d\n", p.linear_waiting);
+  printf("eating_waiting=%d\n", p.eating_waiting);
+  printf("kill_waiting=%d\n", p.kill_waiting);
+  printf("spawning_waiting=%d\n", p.spawning_waiting);
+  printf("incubation_period=%d\n", p.incubation_period);
+  printf("juvenile_period=%d\n", p.juvenile_period);
+  printf("species_metric=%s\n", p.species_cosine ? "cosine" : "l2");
+  printf("species_threshold=%g\n", p.species_threshold);
+  printf("activation=%s\n", p.activation >= 0 && p.activation < ACTIVATIONS ? ACTIVATION_NAMES[p.activation] : "?");
+}
+
+// rates over the last interval, per frame for the phases
+void print_line(const MonitorData &d, const MonitorData &last, double seconds) {
+  int frames = d.frame - last.frame;
+  printf("frame=%d fps=%.0f live=%d species=%d genomes=%d births=%llu deaths=%llu mean_score=%.2f max_age=%d",
+         d.frame, frames / seconds, d.stats.live, d.species, d.distinct_genomes,
+         (unsigned long long)d.stats.births,
+         (unsigned long long)(d.stats.deaths[DEATH_STARVATION] + d.stats.deaths[DEATH_KILLED]),
+         d.stats.mean_score, d.stats.max_age);
+  for (int i = 0; i < PHASES; i++) {
+    printf(" %s_us=%.1f", PHASE_NAMES[i], frames > 0 ? (d.phase_ns[i] - last.phase_ns[i]) / 1000.0 / frames : 0.0);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  bool follow = false;
+  const char *target = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-f") == 0) {
+      follow = true;
+    } else {
+      target = argv[i];
+    }
+  }
+  if (!target) {
+    printf("usage: monitor [-f] <pid>\n");
+    return 1;
+  }
+  string name = target[0] == '/' ? string(target) : monitor_name(atoi(target));
+
+  MonitorReader reader;
+  if (!reader.attach(name)) {
+    printf("no sim at %s\n", name.c_str());
+    return 1;
+  }
+  MonitorData data;
+  if (!reader.read(data)) {
+    printf("could not read %s\n", name.c_str());
+    return 1;
+  }
+  if (!follow) {
+    print_all(data);
+    return 0;
+  }
+
+  const int INTERVAL_US = 1000000;
+  MonitorData last = data;
+  while (true) {
+    usleep(INTERVAL_US);
+    // the segment is unlinked when the sim exits
+    MonitorReader check;
+    if (!check.attach(name) || !reader.read(data)) {
+      break;
+    }
+    print_line(data, last, INTERVAL_US / 1e6);
+    last = data;
+  }
+  return 0;
+}
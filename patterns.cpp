@@ -17,22 +17,24 @@ float mutate_rate = 0.0f;
 float mutate_amount = 0.0f;
 float dna_multiplier = 0.0f;
 int turbo_rate = 0;
+std::string species_metric = "l2";
+float species_threshold = 2.0f;
+int activation = ACTIVATION_EXACT;
+int islands = 1;
+int migration_interval = 5000;
+int migrants = 2;
+std::string migration_topology = "ring";
+int timeline_megabytes = 128;
+std::string genome_bank = "bank";
+std::string seed_bank = "";
+int seed_bank_fill = 0;
 
 struct Agent;
-
-class Sensor {
-public:
-  virtual float sense(const Agent &agent) = 0;
-};
-
-class Behavior {
-public:
-  virtual void behave(Agent &agent, float perceptron_output) = 0;
-};
+AgentHandle handle_of(const Agent &agent);
 
 struct WorldHex {
   char food;
-  Agent *agent;
+  AgentHandle agent;
 };
 
 const int HEX_SIZE = 50;
@@ -42,9 +44,6 @@ const int Q = 20;
 const int R = 20;
 const int WORLD_SIZE = Q * R;
 
-const int DNA_SIZE = 14 * 8 + 8 * 9 + 9;
-const int MEMORY_SIZE = 4;
-
 static bool draw_extra_info = false;
 static bool moving = false;
 static bool nudge = false;
@@ -55,13 +54,15 @@ static float camera_x = HEX_SIZE * R;
 static float camera_y = HEX_SIZE * Q;
 static float camera_zoom = 1.0f;
 static int draw_record = 0;
-static int following = -1;
+static AgentHandle following = 0;
 static int frame = 0;
 static int frame_rate = 1;
 static int moving_home_x;
 static int moving_home_y;
 static int records_index = 0;
 static int zooming_home;
+static bool redraw = false;
+static int scrub_frame = -1;  // the past frame on show, or -1 for the present
 
 void cubic_to_axial(int x, int y, int z, int &q, int &r) {
   q = x;
@@ -94,6 +95,37 @@ void axial_to_xy(int q, int r, int &x, int &y) {
   y = HEX_SIZE * sqrtf(3.0f) * (r + q / 2.0f);
 }
 
+// The hexes a camera shows, with a hex's margin for the parts of agents
+// that reach past their own: columns [q0, q1), and rows of each column from
+// rows().
+struct Viewport {
+  float y0, y1;
+  int q0, q1;
+
+  Viewport(float camera_x, float camera_y, float zoom) {
+    float half_w = WIDTH / 2.0f / zoom + HEX_SIZE;
+    float half_h = HEIGHT / 2.0f / zoom + HEX_SIZE;
+    float column_w = HEX_SIZE * 3.0f / 2.0f;
+    q0 = max(0, (int)floorf((camera_x - half_w) / column_w));
+    q1 = min(Q, (int)ceilf((camera_x + half_w) / column_w) + 1);
+    y0 = camera_y - half_h;
+    y1 = camera_y + half_h;
+  }
+
+  // rows [r0, r1) of column q
+  void rows(int q, int &r0, int &r1) const {
+    float row_h = HEX_SIZE * sqrtf(3.0f);
+    r0 = max(0, (int)floorf(y0 / row_h - q / 2.0f));
+    r1 = min(R, (int)ceilf(y1 / row_h - q / 2.0f) + 1);
+  }
+
+  bool contains(int q, int r) const {
+    int r0, r1;
+    rows(q, r0, r1);
+    return q >= q0 && q < q1 && r >= r0 && r < r1;
+  }
+};
+
 void cubic_add(int &x, int &y, int &z, int dx, int dy, int dz) {
   x = x + dx;
   y = y + dy;
@@ -156,35 +188,88 @@ int direction_add(int direction, int rotation) {
 // }
 
 const int DAY_LENGTH = 2000;
-const int max_agents = 2000;
+const int RECORD_AGENTS = 2000;
 const int RECORD_SAMPLE_RATE = 1000;
+const int SPECIES_RATE = 250;
+const int KEYFRAME_INTERVAL = 1000;
+const int SCRUB_STEP = 100;
 
 static std::random_device rd;
-static std::mt19937 gen(rd());
-static std::uniform_real_distribution<float> fdis(0, 1);
-static std::normal_distribution<float> norm_dist(0, 1);
-
+static uint64_t seed = (uint64_t)rd() << 32 | rd();
+static Random rng(seed);
+static Random migration_rng((uint64_t)rd() << 32 | rd());  // kept off the world's path
+
+static GenomePool genome_pool;
+static Scheduler scheduler;
+static Lineage lineage("lineage");
+static Species species;
+static PopulationStats stats;
+static MonitorWriter monitor;
+static Archipelago archipelago;
+static bool headless = false;  // islands after the first have no window
+static uint64_t emigrants = 0;
+static uint64_t immigrants = 0;
+static Timeline timeline;
+static JournalWriter journal;
+static JournalReader replay_journal;
+static bool replaying = false;
+static WorldView scrub_view;
+static BankWriter bank;
+static BankReader seeds;
+static Tracer tracer;
+
+// Agents are only visited on the frames they are scheduled for, so age and
+// health are kept lazily: health_points is as of frame touched, and settle()
+// brings it up to the current frame.
 struct Agent {
+  uint64_t id;
+  int slot;
   bool out;
   float health_points;
   float hue;
   int q, r, orientation;
   int score;
   int waiting;
-  int age;
+  int born;
+  int touched;
+  int next_action;
+  int parked;  // frame it was parked above num_agents, or -1 in play
+  int species;
   
   float memory[MEMORY_SIZE];
-  float dna[DNA_SIZE];
+  GenomeId genome;
 
   Agent() {
+    this->id = 0;
     this->out = true;
+    this->genome = -1;
+    this->parked = -1;
+    this->species = -1;
   }
 
   void randomize() {
+    float genes[DNA_SIZE];
+    rng.normals(genes, DNA_SIZE);
     for (int i = 0; i < DNA_SIZE; i++) {
-      dna[i] = norm_dist(gen) * dna_multiplier;
+      genes[i] *= dna_multiplier;
     }
-    this->hue = fabs((float)((int)(fdis(gen) * 100.0f) % 100) / 100.0f);
+    assign(genes, fabs((float)((int)(rng.uniform() * 100.0f) % 100) / 100.0f));
+  }
+
+  void assign(const float *genes, float hue) {
+    AgentGenome dna;
+    dna.assign(genes);
+    take_genome(genome_pool.acquire(dna));
+    this->hue = hue;
+  }
+
+  // an agent holds its genome expanded for as long as it has it, to think
+  // with; the reference taken is handed over
+  void take_genome(GenomeId genome) {
+    genome_pool.let_go(this->genome);
+    genome_pool.release(this->genome);
+    this->genome = genome;
+    genome_pool.hold(genome);
   }
 
   void reset_agent() {
@@ -192,56 +277,149 @@ struct Agent {
     this->score = 0;
     this->out = false;
     this->waiting = 0;
-    this->age = 0;
+    this->born = frame;
+    this->touched = frame;
+    this->next_action = frame;
+    this->parked = -1;
     WorldHex *hex;
     do {
-      this->q = Q * fdis(gen);
-      this->r = R * fdis(gen);
+      this->q = Q * rng.uniform();
+      this->r = R * rng.uniform();
       hex = hex_axial(this->q, this->r);
     } while (hex == 0 || hex->agent != 0);
-    this->orientation = 6 * fdis(gen);
-    hex_axial(this->q, this->r)->agent = this;
+    this->orientation = 6 * rng.uniform();
+    hex_axial(this->q, this->r)->agent = handle_of(*this);
   }
 
-  void init_from_parent(Agent *parent) {
-    for (int i = 0; i < DNA_SIZE-1; i++) {
-      if (fdis(gen) < mutate_rate) {
-        this->dna[i] = parent->dna[i] + (norm_dist(gen) * mutate_amount);  
-      } else {
-        this->dna[i] = parent->dna[i];
-      }
+  // returns the number of genes mutated
+  int init_from_parent(Agent *parent) {
+    GeneEdit edits[DNA_SIZE];
+    int count = 0;
+    for (int i = rng.skip(mutate_rate); i < DNA_SIZE; i += 1 + rng.skip(mutate_rate)) {
+      float delta = rng.normal() * mutate_amount;
+      float u = AgentGenome::DITHERED ? rng.uniform() : 0.0f;
+      edits[count].index = i;
+      edits[count].value = genome_pool.mutated(parent->genome, i, delta, u);
+      count++;
     }
+    take_genome(genome_pool.derive(parent->genome, edits, count));
     this->hue = parent->hue;
+    return count;
   }
   
-  inline bool is_egg() {
-      return this->age < incubation_period;
+  inline int age() const {
+      return frame - this->born;
+  }
+
+  inline int hatch() const {
+      return this->born + incubation_period;
+  }
+
+  inline bool is_egg() const {
+      return age() < incubation_period;
   }
   
-  inline bool is_juvenile() {
-      return (this->age >= incubation_period) 
-              && (this->age - incubation_period) < juvenile_period;
+  inline bool is_juvenile() const {
+      return (age() >= incubation_period) 
+              && (age() - incubation_period) < juvenile_period;
   }
   
-  inline bool is_adult() {
+  inline bool is_adult() const {
       return ! is_egg() && ! is_juvenile();
   }
+
+  void decode(float *genes) const {
+    genome_pool.expanded(this->genome).decode(genes);
+  }
+
+  // newborns are the only agents placed in a species
+  void join_species() {
+    float genes[DNA_SIZE];
+    decode(genes);
+    this->species = ::species.join(genes, this->hue);
+  }
+
+  // frames since touched that burned health; eggs do not burn
+  inline int burned_frames() const {
+      return max(0, frame - max(this->touched, hatch() - 1));
+  }
+
+  inline float health() const {
+      return this->health_points - burn_rate * burned_frames();
+  }
+
+  void settle() {
+    this->health_points = health();
+    this->touched = frame;
+  }
+
+  // off the wheel above num_agents; health and age stop where they are
+  void park() {
+    settle();
+    this->parked = frame;
+    stats.park(this->slot, this->score);
+  }
+
+  // back in play as old and as healthy as when it was parked, with the
+  // same wait left before it acts
+  void unpark() {
+    assert(this->parked >= 0);
+    int span = frame - this->parked;
+    this->born += span;
+    this->touched += span;
+    this->next_action += span;
+    this->parked = -1;
+    stats.unpark(this->slot, this->born, this->score);
+  }
+
+  // first frame at which health will have run out
+  int death_frame() const {
+    if (this->health_points <= 0.0f) {
+      return this->touched;
+    }
+    if (burn_rate <= 0.0f) {
+      return std::numeric_limits<int>::max() / 2;
+    }
+    float frames = ceilf(this->health_points / burn_rate);
+    int start = max(this->touched, hatch() - 1);
+    return start + (int)min(frames, (float)(std::numeric_limits<int>::max() / 4));
+  }
   
 };
 
-Agent agents[max_agents];
+static AgentPool<Agent> agents;
+
+AgentHandle handle_of(const Agent &agent) {
+  return agents.handle(agent.slot);
+}
+
+// wake an agent at its next action, when it hatches or when it starves,
+// whichever comes first
+void schedule_agent(Agent &agent) {
+  int due = min(max(agent.next_action, agent.hatch()), agent.death_frame());
+  scheduler.schedule(agent.slot, max(due, frame + 1));
+}
 
-int select() {
-  int total_score = 0;
+void settle_all() {
   for (int i = 0; i < num_agents; i++) {
-    Agent &agent = agents[i];
-    if (agent.out) {
-      continue;
+    if (!agents[i].out) {
+      agents[i].settle();
     }
-    total_score += agent.score;
   }
+}
+
+void schedule_all() {
+  for (int i = 0; i < num_agents; i++) {
+    if (!agents[i].out) {
+      schedule_agent(agents[i]);
+    }
+  }
+}
+
+int select(Random &random) {
+  int total_score = (int)stats.total_score();
   int selected_index = 0;
-  int random_score = (int)(fdis(gen) * (float)total_score);
+  int random_score = (int)(random.uniform() * (float)total_score);
   for (int i = 0; i < num_agents && random_score >= 0.0f; i++) {
     Agent agent = agents[i];
     if (agent.out) {
@@ -253,187 +431,617 @@ int select() {
   return selected_index;
 }
 
-void remove_from_world(Agent &agent) {
+AgentView view_of(const Agent &agent) {
+  AgentView view;
+  view.hue = agent.hue;
+  view.health_points = agent.health_points;
+  view.born = agent.born;
+  view.touched = agent.touched;
+  view.q = agent.q;
+  view.r = agent.r;
+  view.orientation = agent.orientation;
+  view.out = agent.out;
+  return view;
+}
+
+// health at frame at, the way Agent::health() works it out
+float view_health(const AgentView &view, int at) {
+  int burned = max(0, at - max(view.touched, view.born + incubation_period - 1));
+  return view.health_points - burn_rate * burned;
+}
+
+void record_birth(const Agent &agent) {
+  timeline.birth(frame, agent.slot, agent.q, agent.r, agent.orientation, agent.hue, agent.health_points);
+}
+
+// the first free slot among the agents in play, or 0
+Agent *vacancy() {
+  for (int i = 0; i < num_agents; i++) {
+    if (agents[i].out) {
+      return &agents[i];
+    }
+  }
+  return 0;
+}
+
+// places an agent with no parent on this island, given its genome
+void place_newcomer(Agent &agent) {
+  agent.reset_agent();
+  agent.id = lineage.birth(0, frame, 0);
+  agent.join_species();
+  stats.birth(agent.id, agent.slot, frame);
+  record_birth(agent);
+  schedule_agent(agent);
+}
+
+BankRecord bank_record(const Agent &agent) {
+  BankRecord record;
+  record.id = agent.id;
+  record.island = archipelago.island();
+  record.frame = frame;
+  record.born = agent.born;
+  record.score = agent.score;
+  record.hue = agent.hue;
+  agent.decode(record.genes);
+  return record;
+}
+
+// a genome for an agent with no parent: one from the seed bank if there is
+// one, or else noise
+void conceive(Agent &agent) {
+  if (seeds.size() == 0) {
+    agent.randomize();
+    return;
+  }
+  const BankRecord &record = seeds[(int)(rng.uniform() * seeds.size())];
+  agent.assign(record.genes, record.hue);
+}
+
+// Fills the world with up to seed_bank_fill agents from the seed bank at
+// the start of a run, as many as there are free slots and hexes for.
+void seed_world() {
+  int hexes = 0;
+  for (int i = 0; i < WORLD_SIZE; i++) {
+    hexes += world[i].agent == 0;
+  }
+  for (int n = min(seed_bank_fill, hexes); n > 0 && seeds.size() > 0; n--) {
+    Agent *agent = vacancy();
+    if (agent == 0) {
+      break;
+    }
+    conceive(*agent);
+    place_newcomer(*agent);
+  }
+}
+
+// every live agent, so that what a run evolved outlives it
+void bank_survivors() {
+  for (int i = 0; i < agents.capacity(); i++) {
+    if (!agents[i].out) {
+      bank.append(bank_record(agents[i]));
+    }
+  }
+}
+
+// copies of select()ed genomes to the next islands along the topology; the
+// originals stay, and a full mailbox turns a copy away. Selection draws from
+// its own generator, so the world's path is the same however many islands
+// it sends to, and a replay need not send at all.
+void migrate() {
+  static std::vector<int> destinations;
+  archipelago.destinations(migration_topology == "full" ? TOPOLOGY_FULL : TOPOLOGY_RING, destinations);
+  for (size_t d = 0; d < destinations.size(); d++) {
+    Mailbox &outbox = archipelago.outbox(destinations[d]);
+    for (int m = 0; m < migrants; m++) {
+      const Agent &agent = agents[select(migration_rng)];
+      if (agent.out) {
+        return;
+      }
+      Migrant migrant;
+      agent.decode(migrant.genes);
+      migrant.hue = agent.hue;
+      emigrants += outbox.send(migrant);
+    }
+  }
+}
+
+// in a replay, the next journaled entry if it is of this frame and kind
+bool replayed(JournalKind kind, JournalEntry &entry) {
+  const JournalEntry *next = replay_journal.peek();
+  if (!replaying || next == 0 || next->frame != frame || next->kind != kind) {
+    return false;
+  }
+  entry = *next;
+  replay_journal.pop();
+  return true;
+}
+
+// a migrant that has arrived takes a free slot; with none free it is lost
+void welcome_migrant(const Migrant &migrant) {
+  Agent *agent = vacancy();
+  if (agent == 0) {
+    return;
+  }
+  agent->assign(migrant.genes, migrant.hue);
+  place_newcomer(*agent);
+  immigrants++;
+}
+
+void welcome_migrants() {
+  if (replaying) {
+    JournalEntry entry;
+    while (replayed(JOURNAL_MIGRANT, entry)) {
+      welcome_migrant(entry.migrant);
+    }
+    return;
+  }
+  Migrant migrant;
+  for (int from = 0; from < archipelago.size(); from++) {
+    if (from == archipelago.island()) {
+      continue;
+    }
+    Mailbox &inbox = archipelago.inbox(from);
+    while (inbox.receive(migrant)) {
+      journal.migrant(frame, migrant);
+      welcome_migrant(migrant);
+    }
+  }
+}
+
+void clear_food() {
+  for (int i = 0; i < WORLD_SIZE; i++) {
+    if (world[i].food) {
+      world[i].food = 0;
+      timeline.food(frame, i, 0);
+    }
+  }
+}
+
+static uint64_t fnv(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// everything the world carries from one frame to the next, hashed, so a
+// replay can show it is on the same path
+uint64_t world_hash() {
+  uint64_t hash = fnv(14695981039346656037ULL, &frame, sizeof(frame));
+  // the generator by what it will draw next; its bytes hold caches too
+  Random ahead = rng;
+  for (int i = 0; i < 4; i++) {
+    float draws[2] = { ahead.uniform(), ahead.normal() };
+    hash = fnv(hash, draws, sizeof(draws));
+  }
+  for (int i = 0; i < agents.capacity(); i++) {
+    const Agent &agent = agents[i];
+    if (agent.out) {
+      continue;
+    }
+    hash = fnv(hash, &i, sizeof(i));
+    hash = fnv(hash, &agent.id, sizeof(agent.id));
+    hash = fnv(hash, &agent.health_points, sizeof(agent.health_points));
+    hash = fnv(hash, &agent.q, sizeof(agent.q));
+    hash = fnv(hash, &agent.r, sizeof(agent.r));
+    hash = fnv(hash, &agent.orientation, sizeof(agent.orientation));
+    hash = fnv(hash, &agent.score, sizeof(agent.score));
+    hash = fnv(hash, &agent.touched, sizeof(agent.touched));
+    hash = fnv(hash, &agent.next_action, sizeof(agent.next_action));
+    hash = fnv(hash, agent.memory, sizeof(agent.memory));
+  }
+  for (int i = 0; i < WORLD_SIZE; i++) {
+    hash = fnv(hash, &world[i].food, sizeof(world[i].food));
+  }
+  return hash;
+}
+
+void remove_from_world(Agent &agent, DeathCause cause) {
   if (!agent.out) {
+    lineage.death(agent.id, frame, agent.age(), agent.score, cause);
+    stats.death(agent.id, agent.slot, agent.born, agent.score, cause);
     WorldHex *hex = hex_axial(agent.q, agent.r);
     assert(hex != 0);
-    assert(hex->agent == &agent);
+    assert(hex->agent == handle_of(agent));
     hex->agent = 0;
     agent.out = true;
+    // its trace ends with it, and its ring is free for another agent
+    if (tracer.active()) {
+      tracer.end(handle_of(agent));
+    }
+    agents.retire(agent.slot);
+    timeline.death(frame, agent.slot);
+    scheduler.cancel(agent.slot);
+    agent.take_genome(-1);
+    species.leave(agent.species);
+    agent.species = -1;
+  }
+}
+
+// moves every species' centroid to the mean of its members
+void recenter_species() {
+  species.begin_recenter();
+  for (int i = 0; i < agents.capacity(); i++) {
+    const Agent &agent = agents[i];
+    if (agent.out) {
+      continue;
+    }
+    float genes[DNA_SIZE];
+    agent.decode(genes);
+    species.accumulate(agent.species, genes);
   }
+  species.end_recenter();
 }
 
+// Agents are sampled every stride'th slot, so that a record holds at most
+// RECORD_AGENTS of them however large the population.
 struct Record {
-  float hues[max_agents];
-  float dna[DNA_SIZE];
-  int scores[max_agents];
-  bool outs[max_agents];
+  std::vector<float> hues;
+  GenomeId genome;
+  std::vector<int> scores;
+  std::vector<char> outs;
   float selected_hue;
+  int distinct_genomes;
+  int species_count;
+  int species_sizes[Species::MAX_SPECIES];
+  float species_hues[Species::MAX_SPECIES];
 
   Record() {
-    for (int i = 0; i < max_agents; i++)
-      outs[i] = true;
+    genome = -1;
+    distinct_genomes = 0;
+    species_count = 0;
+    for (int s = 0; s < Species::MAX_SPECIES; s++)
+      species_sizes[s] = 0;
   }
 };
 
 static Record records[WIDTH];
+static StatsSnapshot stats_history[WIDTH];
 
-class FoodSensor : public Sensor {
-public:
-  FoodSensor(int relative_direction, int distance) {
-    this->relative_direction = relative_direction;
-    this->distance = distance;
-  }
-  virtual float sense(const Agent &agent) {
-    int direction = direction_add(agent.orientation, relative_direction);
-    int x, y, z;
-    axial_to_cubic(agent.q, agent.r, x, y, z);
-    for (int j = 0; j < distance; j++) {
-      cubic_add_direction(x, y, z, direction);
-    }
-    WorldHex *hex = hex_cubic(x, y, z);
-    if (hex != 0 && hex->food > 0) {
-      return 1.0f;
-    } else {
-      return 0.0f;
-    }
-  }
+static Senses senses = Senses::standard();
 
-private:
-  int relative_direction;
-  int distance;
-};
+float sense(const SensorEntry &sensor, const Agent &agent) {
+  switch (sensor.kind) {
+  case SENSE_FOOD: {
+    WorldHex *hex = hex_axial(agent.q + sensor.dq[agent.orientation], agent.r + sensor.dr[agent.orientation]);
+    return hex != 0 && hex->food > 0 ? 1.0f : 0.0f;
+  }
+  case SENSE_AGENT: {
+    WorldHex *hex = hex_axial(agent.q + sensor.dq[agent.orientation], agent.r + sensor.dr[agent.orientation]);
+    return hex != 0 && hex->agent ? agents.get(hex->agent)->hue : 0.0f;
+  }
+  default:
+    return (float)agent.health_points / (float)max_hp;
+  }
+}
 
-class AgentSensor : public Sensor {
-public:
-  AgentSensor(int relative_direction, int distance) {
-    this->relative_direction = relative_direction;
-    this->distance = distance;
-  }
-  virtual float sense(const Agent &agent) {
-    int direction = direction_add(agent.orientation, relative_direction);
-    int x, y, z;
-    axial_to_cubic(agent.q, agent.r, x, y, z);
-    for (int j = 0; j < distance; j++) {
-      cubic_add_direction(x, y, z, direction);
-    }
-    WorldHex *hex = hex_cubic(x, y, z);
-    if (hex != 0 && hex->agent) {
-      return hex->agent->hue;
-    } else {
-      return 0.0f;
-    }
+void behave_turn(Agent &agent, float perceptron_output) {
+  if (perceptron_output < -0.5f) {
+    agent.orientation = direction_add(agent.orientation, +1);
+    agent.waiting += rotational_waiting;
+  } else if (perceptron_output > +0.5f) {
+    agent.orientation = direction_add(agent.orientation, -1);
+    agent.waiting += rotational_waiting;
   }
+}
 
-private:
-  int relative_direction;
-  int distance;
-};
+void behave_move(Agent &agent) {
+  hex_axial(agent.q, agent.r)->agent = 0;
+  int x, y, z;
+  axial_to_cubic(agent.q, agent.r, x, y, z);
+  int x0 = x, y0 = y, z0 = z;
+  cubic_add_direction(x0, y0, z0, agent.orientation);
+  WorldHex *hex = hex_cubic(x0, y0, z0);
+  bool moved = hex != 0 && hex->agent == 0;
+  if (moved) {
+    x = x0;
+    y = y0;
+    z = z0;
+    agent.waiting += linear_waiting;
+  }
+  stats.move(moved);
+  cubic_to_axial(x, y, z, agent.q, agent.r);
+  hex_axial(agent.q, agent.r)->agent = handle_of(agent);
+}
 
-class SelfHealthPointsSensor : public Sensor {
-public:
-  virtual float sense(const Agent &agent) {
-    return (float)agent.health_points / (float)max_hp;
+void behave_kill(Agent &agent) {
+  int x, y, z;
+  axial_to_cubic(agent.q, agent.r, x, y, z);
+  int targetx = x, targety = y, targetz = z;
+  cubic_add_direction(targetx, targety, targetz, agent.orientation);
+  WorldHex *hex = hex_cubic(targetx, targety, targetz);
+  if (hex != 0 && hex->agent) {
+    Agent *target = agents.get(hex->agent);
+    stats.kill();
+    remove_from_world(*target, DEATH_KILLED);
+    agent.waiting += kill_waiting;
   }
-};
+}
 
-class RotationalBehavior : public Behavior {
-public:
-  virtual void behave(Agent &agent, float perceptron_output) { 
-    if (perceptron_output < -0.5f) {
-      agent.orientation = direction_add(agent.orientation, +1);
-      agent.waiting += rotational_waiting;
-    } else if (perceptron_output > +0.5f) {
-      agent.orientation = direction_add(agent.orientation, -1);
-      agent.waiting += rotational_waiting;
-    }
+void behave_eat(Agent &agent) {
+  WorldHex *hex = hex_axial(agent.q, agent.r);
+  if (hex != 0 && hex->food > 0) {
+    hex->food = 0;
+    timeline.food(frame, (int)(hex - world), 0);
+    agent.health_points = min(max_hp, agent.health_points + food_value);
+    stats.meal(agent.score);
+    agent.score++;
+    agent.waiting += eating_waiting;
   }
-};
+}
 
-class LinearBehavior : public Behavior {
-public:
-  virtual void behave(Agent &agent, float perceptron_output) {
-    hex_axial(agent.q, agent.r)->agent = 0;
-    int x, y, z;
-    axial_to_cubic(agent.q, agent.r, x, y, z);
-    int x0 = x, y0 = y, z0 = z;
-    cubic_add_direction(x0, y0, z0, agent.orientation);
-    WorldHex *hex = hex_cubic(x0, y0, z0);
+void behave_spawn(Agent &agent) {
+  if (! agent.is_adult()) {
+      return;
+  }
+  bool spawned = false;
+  int new_index = 0;
+  while (new_index < num_agents && !agents[new_index].out) {
+    new_index++;
+  }
+  if (new_index < num_agents) {
+    int new_q = agent.q;
+    int new_r = agent.r;
+    axial_add_direction(new_q, new_r, agent.orientation);
+    WorldHex *hex = hex_axial(new_q, new_r);
     if (hex != 0 && hex->agent == 0) {
-      x = x0;
-      y = y0;
-      z = z0;
-      agent.waiting += linear_waiting;
+      int mutations = agents[new_index].init_from_parent(&agent);
+      agents[new_index].reset_agent(); 
+      agents[new_index].id = lineage.birth(agent.id, frame, mutations);
+      agents[new_index].join_species();
+      stats.birth(agents[new_index].id, new_index, frame);
+      hex_axial(agents[new_index].q, agents[new_index].r)->agent = 0;
+      agents[new_index].q = new_q;
+      agents[new_index].r = new_r;
+      agents[new_index].orientation = agent.orientation;
+      hex_axial(agents[new_index].q, agents[new_index].r)->agent = handle_of(agents[new_index]);
+      record_birth(agents[new_index]);
+      schedule_agent(agents[new_index]);
+      agent.waiting += spawning_waiting;
+      spawned = true;
     }
-    cubic_to_axial(x, y, z, agent.q, agent.r);
-    hex_axial(agent.q, agent.r)->agent = &agent;
   }
-};
+  stats.spawn(spawned);
+}
 
-class KillBehavior : public Behavior {
-public:
-  virtual void behave(Agent &agent, float perceptron_output) {
-    int x, y, z;
-    axial_to_cubic(agent.q, agent.r, x, y, z);
-    int targetx = x, targety = y, targetz = z;
-    cubic_add_direction(targetx, targety, targetz, agent.orientation);
-    WorldHex *hex = hex_cubic(targetx, targety, targetz);
-    if (hex != 0 && hex->agent) {
-      Agent *target = hex->agent;
-      remove_from_world(*target);
-      agent.waiting += kill_waiting;
-    }
+// whether a behavior's output sets it off, as step() decides
+bool fires(int behavior, float output, float gain) {
+  return behavior == BEHAVE_TURN ? fabsf(output * gain) > 0.5f : output > gain;
+}
+
+// the decision an agent is about to act on, if it is being traced
+void trace_decision(const Agent &agent, const float *inputs, const float *hidden, const float *outputs,
+                    const float *gains) {
+  int ring = tracer.ring_of(handle_of(agent));
+  if (ring < 0) {
+    return;
   }
-};
+  TraceRecord &record = tracer.record(ring);
+  record.frame = frame;
+  record.q = agent.q;
+  record.r = agent.r;
+  record.orientation = agent.orientation;
+  record.health_points = agent.health_points;
+  record.fired = 0;
+  for (int b = 0; b < BEHAVIOR_COUNT; b++) {
+    record.fired |= fires(senses.behaviors[b], outputs[b], gains[b]) << b;
+  }
+  memcpy(record.inputs, inputs, sizeof(record.inputs));
+  memcpy(record.hidden, hidden, sizeof(record.hidden));
+  memcpy(record.outputs, outputs, sizeof(record.outputs));
+}
 
-class EatingBehavior : public Behavior {
-public:
-  virtual void behave(Agent &agent, float perceptron_output) {
-    WorldHex *hex = hex_axial(agent.q, agent.r);
-    if (hex != 0 && hex->food > 0) {
-      hex->food = 0;
-      agent.health_points = min(max_hp, agent.health_points + food_value);
-      agent.score++;
-      agent.waiting += eating_waiting;
-    }
+// traces the followed agent's decisions, or stops
+void toggle_trace() {
+  const Agent *followed = agents.get(following);
+  if (followed == 0 || followed->out) {
+    return;
   }
-};
+  if (tracer.ring_of(following) >= 0) {
+    tracer.deselect(following);
+    printf("trace=off id=%llu\n", (unsigned long long)followed->id);
+  } else {
+    tracer.select(following, followed->id, frame);
+    printf("trace=on id=%llu\n", (unsigned long long)followed->id);
+  }
+}
 
-class SpawningBehavior : public Behavior {
-public:
-  virtual void behave(Agent &agent, float perceptron_output) {
-    if (! agent.is_adult()) {
-        return;
-    }
-    int new_index = 0;
-    while (new_index < num_agents && !agents[new_index].out) {
-      new_index++;
-    }
-    if (new_index < num_agents) {
-      int new_q = agent.q;
-      int new_r = agent.r;
-      axial_add_direction(new_q, new_r, agent.orientation);
-      WorldHex *hex = hex_axial(new_q, new_r);
-      if (hex != 0 && hex->agent == 0) {
-        agents[new_index].init_from_parent(&agent);
-        agents[new_index].reset_agent(); 
-        hex_axial(agents[new_index].q, agents[new_index].r)->agent = 0;
-        agents[new_index].q = new_q;
-        agents[new_index].r = new_r;
-        agents[new_index].orientation = agent.orientation;
-        hex_axial(agents[new_index].q, agents[new_index].r)->agent = &agents[new_index];
-        agent.waiting += spawning_waiting;
+void dump_trace() {
+  if (tracer.kept() > 0 && tracer.dump("trace")) {
+    printf("trace dumped\n");
+  }
+}
+
+void print_following() {
+  const Agent *followed = agents.get(following);
+  if (followed == 0 || followed->out) {
+    printf("following=none\n");
+    return;
+  }
+  const Agent &agent = *followed;
+  static std::vector<uint64_t> ancestors;
+  lineage.ancestors(agent.id, ancestors);
+  printf("following=%d id=%llu generation=%d species=%d\n",
+         agent.slot, (unsigned long long)agent.id, (int)ancestors.size(), agent.species);
+}
+
+// follows the next live agent along the slots, one way or the other
+void follow_next(int direction) {
+  if (num_agents > 0) {
+    int i = following ? AgentPool<Agent>::index_of(following) % num_agents : direction > 0 ? num_agents - 1 : 0;
+    following = 0;
+    for (int n = 0; n < num_agents; n++) {
+      i = (i + direction + num_agents) % num_agents;
+      if (!agents[i].out) {
+        following = agents.handle(i);
+        break;
       }
     }
   }
-};
+  print_following();
+}
 
 void init() {
   eg_init(WIDTH, HEIGHT, "Patterns of Life");
   setlocale(LC_NUMERIC, "");
+  monitor.open(monitor_name(getpid()));
+  timeline.allocate(agents.capacity(), KEYFRAME_INTERVAL, ((size_t)timeline_megabytes << 20) / sizeof(TimelineDelta));
+}
+
+// the whole world view, every KEYFRAME_INTERVAL frames
+void keyframe() {
+  static WorldView view;
+  view.frame = frame;
+  view.agents.resize(agents.capacity());
+  for (int i = 0; i < agents.capacity(); i++) {
+    view.agents[i] = view_of(agents[i]);
+  }
+  view.food.resize(WORLD_SIZE);
+  for (int i = 0; i < WORLD_SIZE; i++) {
+    view.food[i] = world[i].food;
+  }
+  timeline.keyframe(view);
+}
+
+// moves the world view back or forward through the timeline, pausing the
+// sim on the way; going forward past the last frame returns to the present
+void scrub(int frames) {
+  int last = frame - 1;
+  int from = scrub_frame >= 0 ? scrub_frame : last;
+  int to = max(from + frames, timeline.earliest());
+  if (to < last && timeline.seek(to, scrub_view)) {
+    scrub_frame = to;
+    printf("scrub=%d back=%d\n", scrub_frame, last - scrub_frame);
+  } else {
+    scrub_frame = -1;
+    printf("scrub=live\n");
+  }
+  paused = true;
+  redraw = true;
+}
+
+Parameters current_parameters() {
+  Parameters p;
+  p.num_agents = num_agents;
+  p.agent_spawn_rate = agent_spawn_rate;
+  p.food_spawn_rate = food_spawn_rate;
+  p.food_value = food_value;
+  p.max_hp = max_hp;
+  p.rotational_waiting = rotational_waiting;
+  p.linear_waiting = linear_waiting;
+  p.eating_waiting = eating_waiting;
+  p.kill_waiting = kill_waiting;
+  p.spawning_waiting = spawning_waiting;
+  p.incubation_period = incubation_period;
+  p.juvenile_period = juvenile_period;
+  p.burn_rate = burn_rate;
+  p.mutate_rate = mutate_rate;
+  p.mutate_amount = mutate_amount;
+  p.dna_multiplier = dna_multiplier;
+  p.species_threshold = species_threshold;
+  p.species_cosine = species_metric == "cosine";
+  p.activation = activation;
+  return p;
+}
+
+void apply_parameters(const Parameters &p) {
+  int previous = num_agents;
+  num_agents = min(p.num_agents, (int)AgentPool<Agent>::MAX_SLOTS);
+  agents.reserve(num_agents);
+  // agents above num_agents are parked, settled under the old values and
+  // frozen until it reaches them again
+  for (int i = num_agents; i < previous; i++) {
+    if (!agents[i].out) {
+      agents[i].park();
+    }
+  }
+  for (int i = previous; i < num_agents; i++) {
+    if (!agents[i].out) {
+      agents[i].unpark();
+    }
+  }
+  timeline.grow(agents.capacity());
+  agent_spawn_rate = p.agent_spawn_rate;
+  food_spawn_rate = p.food_spawn_rate;
+  food_value = p.food_value;
+  max_hp = p.max_hp;
+  rotational_waiting = p.rotational_waiting;
+  linear_waiting = p.linear_waiting;
+  eating_waiting = p.eating_waiting;
+  kill_waiting = p.kill_waiting;
+  spawning_waiting = p.spawning_waiting;
+  // agents are scheduled against these two, so settle everyone under the
+  // old values before rescheduling them under the new ones
+  if (p.burn_rate != burn_rate || p.incubation_period != incubation_period) {
+    settle_all();
+    burn_rate = p.burn_rate;
+    incubation_period = p.incubation_period;
+    schedule_all();
+  }
+  // parked agents left the wheel, so put back any num_agents now reaches
+  for (int i = previous; i < num_agents; i++) {
+    if (!agents[i].out) {
+      schedule_agent(agents[i]);
+    }
+  }
+  mutate_rate = p.mutate_rate;
+  mutate_amount = p.mutate_amount;
+  dna_multiplier = p.dna_multiplier;
+  juvenile_period = p.juvenile_period;
+  species_metric = p.species_cosine ? "cosine" : "l2";
+  species_threshold = p.species_threshold;
+  species.configure(p.species_cosine ? Species::COSINE : Species::L2, species_threshold);
+  activation = p.activation;
 }
 
 Config cfg;
+// The sensor and behavior layout config declares, if it does; one that does
+// not fit the network is turned away whole, and the layout stays as it was.
+void read_senses(const Setting &root, Senses &out) {
+  Senses declared = out;
+  if (root.exists("sensors")) {
+    const Setting &list = root.lookup("sensors");
+    if (list.getLength() != SENSOR_COUNT) {
+      printf("sensors: the network reads %d, config declares %d\n", SENSOR_COUNT, list.getLength());
+      return;
+    }
+    for (int s = 0; s < SENSOR_COUNT; s++) {
+      std::string kind;
+      int direction = 0, distance = 0;
+      list[s].lookupValue("kind", kind);
+      list[s].lookupValue("direction", direction);
+      list[s].lookupValue("distance", distance);
+      int k = kind_named(SENSOR_KIND_NAMES, kind);
+      if (k < 0 || distance < 0) {
+        printf("sensors: %d is not a sensor\n", s);
+        return;
+      }
+      declared.sensors[s] = Senses::sensor(k, direction, distance);
+    }
+  }
+  if (root.exists("behaviors")) {
+    const Setting &list = root.lookup("behaviors");
+    if (list.getLength() != BEHAVIOR_COUNT) {
+      printf("behaviors: the network drives %d, config declares %d\n", BEHAVIOR_COUNT, list.getLength());
+      return;
+    }
+    for (int b = 0; b < BEHAVIOR_COUNT; b++) {
+      if (list[b].getType() != Setting::TypeString) {
+        printf("behaviors: %d is not a behavior\n", b);
+        return;
+      }
+      const char *kind = list[b];
+      declared.behaviors[b] = kind_named(BEHAVIOR_KIND_NAMES, kind);
+      if (declared.behaviors[b] < 0) {
+        printf("behaviors: unknown behavior %s\n", kind);
+        return;
+      }
+    }
+  }
+  out = declared;
+}
+
 void refreshConfig() {
     try {
         cfg.readFile("config");
@@ -449,63 +1057,507 @@ void refreshConfig() {
     }
 
   Setting& root = cfg.getRoot();
-  root.lookupValue("num_agents", num_agents);
-  root.lookupValue("agent_spawn_rate", agent_spawn_rate);
-  num_agents = min(num_agents, max_agents);
-  root.lookupValue("food_spawn_rate", food_spawn_rate);
-  root.lookupValue("food_value", food_value);
-  root.lookupValue("max_hp", max_hp);
-  root.lookupValue("rotational_waiting", rotational_waiting);
-  root.lookupValue("linear_waiting", linear_waiting);
-  root.lookupValue("eating_waiting", eating_waiting);
-  root.lookupValue("kill_waiting", kill_waiting);
-  root.lookupValue("spawning_waiting", spawning_waiting);
-  root.lookupValue("burn_rate", burn_rate);
-  root.lookupValue("mutate_rate", mutate_rate);
-  root.lookupValue("mutate_amount", mutate_amount);
-  root.lookupValue("dna_multiplier", dna_multiplier);
+  // a run starts from the defaults, and config changes them from there
+  Parameters p = frame == 0 ? default_parameters() : current_parameters();
+  std::string metric = p.species_cosine ? "cosine" : "l2";
+  std::string tanh_name = ACTIVATION_NAMES[p.activation];
+  root.lookupValue("num_agents", p.num_agents);
+  root.lookupValue("agent_spawn_rate", p.agent_spawn_rate);
+  root.lookupValue("food_spawn_rate", p.food_spawn_rate);
+  root.lookupValue("food_value", p.food_value);
+  root.lookupValue("max_hp", p.max_hp);
+  root.lookupValue("rotational_waiting", p.rotational_waiting);
+  root.lookupValue("linear_waiting", p.linear_waiting);
+  root.lookupValue("eating_waiting", p.eating_waiting);
+  root.lookupValue("kill_waiting", p.kill_waiting);
+  root.lookupValue("spawning_waiting", p.spawning_waiting);
+  root.lookupValue("burn_rate", p.burn_rate);
+  root.lookupValue("incubation_period", p.incubation_period);
+  root.lookupValue("mutate_rate", p.mutate_rate);
+  root.lookupValue("mutate_amount", p.mutate_amount);
+  root.lookupValue("dna_multiplier", p.dna_multiplier);
+  root.lookupValue("juvenile_period", p.juvenile_period);
+  root.lookupValue("species_metric", metric);
+  root.lookupValue("species_threshold", p.species_threshold);
+  p.species_cosine = metric == "cosine";
+  root.lookupValue("activation", tanh_name);
+  if (activation_named(tanh_name) >= 0) {
+    p.activation = activation_named(tanh_name);
+  } else {
+    printf("unknown activation: %s\n", tanh_name.c_str());
+  }
   root.lookupValue("turbo_rate", turbo_rate);
-  root.lookupValue("incubation_period", incubation_period);
-  root.lookupValue("juvenile_period", juvenile_period);
+  root.lookupValue("islands", islands);
+  root.lookupValue("migration_interval", migration_interval);
+  root.lookupValue("migrants", migrants);
+  root.lookupValue("migration_topology", migration_topology);
+  root.lookupValue("timeline_megabytes", timeline_megabytes);
+  root.lookupValue("genome_bank", genome_bank);
+  root.lookupValue("seed_bank", seed_bank);
+  root.lookupValue("seed_bank_fill", seed_bank_fill);
+  // agents are wired as the run starts, and stay so
+  if (frame == 0) {
+    read_senses(root, senses);
+  }
+  migration_interval = max(migration_interval, 1);
+
+  Parameters now = current_parameters();
+  if (memcmp(&p, &now, sizeof(p)) != 0) {
+    apply_parameters(p);
+    journal.config(frame, current_parameters());
+  }
 }
 
 long last_refresh;
 long last_refresh_interval = 1000000;
 
-void step() {
+static uint64_t phase_ns[PHASES];
+static steady_clock::time_point phase_start;
 
-  // handle user events
-  EGEvent event;
-  while (eg_poll_event(&event)) {
-    switch (event.type) {
-    case SDL_QUIT: {
-      quit = true;
-      break;
+void end_phase(Phase phase) {
+  steady_clock::time_point now = steady_clock::now();
+  phase_ns[phase] += duration_cast<nanoseconds>(now - phase_start).count();
+  phase_start = now;
+}
+
+void publish_monitor() {
+  MonitorData data;
+  data.frame = frame;
+  data.species = species.count();
+  data.distinct_genomes = genome_pool.distinct();
+  data.island = archipelago.island();
+  data.islands = archipelago.size();
+  data.emigrants = emigrants;
+  data.immigrants = immigrants;
+  memcpy(data.phase_ns, phase_ns, sizeof(phase_ns));
+  data.stats = stats_history[frame % WIDTH];
+  data.parameters = current_parameters();
+  monitor.publish(data);
+}
+
+// hexes drawn smaller than this many pixels across give way to the heatmap
+const float HEATMAP_HEX_PIXELS = 6.0f;
+// texels across the heatmap at most; past that a texel sums a block of hexes
+const int HEATMAP_SIZE = 256;
+
+static EGImage *heatmap = 0;
+static int heatmap_block;
+static std::vector<unsigned char> heatmap_texels;
+static std::vector<int> heatmap_agents, heatmap_food;
+
+// The world at a glance, for when it is too far off to draw hex by hex: a
+// texel to a block of hexes, green with the food in it and bright with the
+// agents. Costs a pass over the world and one texture upload.
+void draw_heatmap(const WorldView *past) {
+  if (heatmap == 0) {
+    heatmap_block = (max(Q, R) + HEATMAP_SIZE - 1) / HEATMAP_SIZE;
+    int w = (Q + heatmap_block - 1) / heatmap_block;
+    int h = (R + heatmap_block - 1) / heatmap_block;
+    heatmap = eg_create_image(w, h);
+    heatmap_texels.resize(w * h * 4);
+    heatmap_agents.resize(w * h);
+    heatmap_food.resize(w * h);
+  }
+  int w = (Q + heatmap_block - 1) / heatmap_block;
+  int h = (R + heatmap_block - 1) / heatmap_block;
+  std::fill(heatmap_agents.begin(), heatmap_agents.end(), 0);
+  std::fill(heatmap_food.begin(), heatmap_food.end(), 0);
+  // the live world counts its agents off the hexes; a scrubbed view has
+  // only its slots, parked ones among them
+  for (int i = 0; i < WORLD_SIZE; i++) {
+    char food = past ? past->food[i] : world[i].food;
+    int t = (i % Q) / heatmap_block + (i / Q) / heatmap_block * w;
+    heatmap_food[t] += food & 1;
+    if (!past) {
+      heatmap_agents[t] += agents.get(world[i].agent) != 0;
     }
-    case SDL_MOUSEBUTTONDOWN: {
-      SDL_MouseButtonEvent e = event.button;
-      break;
+  }
+  for (int i = 0; past && i < (int)past->agents.size(); i++) {
+    if (!past->agents[i].out) {
+      heatmap_agents[past->agents[i].q / heatmap_block + past->agents[i].r / heatmap_block * w]++;
     }
-    case SDL_KEYDOWN: {
-      SDL_KeyboardEvent e = event.key;
-      switch (e.keysym.scancode) {
-      case SDL_SCANCODE_GRAVE:
-        frame_rate = 1;
-        if (paused)
-          nudge = true;
-        else
-          paused = true;
-        break;
-      case SDL_SCANCODE_1:
-        frame_rate = 1;
-        paused = false;
-        break;
-      case SDL_SCANCODE_2:
-        frame_rate = int((float)turbo_rate * 0.04f);
-        paused = false;
-        break;
-      case SDL_SCANCODE_3:
-        frame_rate = int((float)turbo_rate * 0.20f);
+  }
+  float per_texel = 1.0f / (heatmap_block * heatmap_block);
+  for (int t = 0; t < w * h; t++) {
+    float food = heatmap_food[t] * per_texel;
+    float crowd = min(1.0f, heatmap_agents[t] * per_texel * 4.0f);
+    unsigned char *texel = &heatmap_texels[t * 4];
+    texel[0] = (unsigned char)(255.0f * (0.1f + 0.9f * crowd));
+    texel[1] = (unsigned char)(255.0f * (0.2f + 0.3f * food + 0.5f * crowd));
+    texel[2] = (unsigned char)(255.0f * (0.05f + 0.9f * crowd));
+    texel[3] = 255;
+  }
+  eg_update_image(heatmap, heatmap_texels.data());
+
+  // texel edges fall half a hex before the first and after the last, and
+  // hex rows lean, so the texture is a parallelogram
+  float column_w = HEX_SIZE * 3.0f / 2.0f, row_h = HEX_SIZE * sqrtf(3.0f);
+  float q0 = -0.5f, q1 = w * heatmap_block - 0.5f;
+  float r0 = -0.5f, r1 = h * heatmap_block - 0.5f;
+  eg_set_color(1.0f, 1.0f, 1.0f, 1.0f);
+  eg_draw_image_corners(heatmap,
+                        column_w * q0, row_h * (r0 + q0 / 2.0f),
+                        column_w * q1, row_h * (r0 + q1 / 2.0f),
+                        column_w * q1, row_h * (r1 + q1 / 2.0f),
+                        column_w * q0, row_h * (r1 + q0 / 2.0f));
+}
+
+// The followed agent's decision as of frame at, if it is traced, in the
+// top left corner: its inputs, hidden layer and outputs as bars from the
+// middle of a column each, and the outputs that set off a behavior lit.
+void draw_trace(int at) {
+  int ring = tracer.ring_of(following);
+  if (ring < 0) {
+    return;
+  }
+  int ago = 0;
+  while (ago < tracer.size(ring) && tracer.back(ring, ago).frame > at) {
+    ago++;
+  }
+  if (ago == tracer.size(ring)) {
+    return;
+  }
+  const TraceRecord &record = tracer.back(ring, ago);
+  const float row_h = 8.0f, bar_w = 30.0f, left = 10.0f + bar_w;
+  const float *layers[3] = { record.inputs, record.hidden, record.outputs };
+  int sizes[3] = { Brain::INPUTS, HIDDEN_SIZE, Brain::OUTPUTS };
+  for (int l = 0; l < 3; l++) {
+    float x = left + l * (bar_w * 2.0f + 10.0f);
+    eg_set_color(0.2f, 0.2f, 0.2f, 0.7f);
+    eg_draw_square(x - bar_w, HEIGHT - 10.0f - sizes[l] * row_h, bar_w * 2.0f, sizes[l] * row_h);
+    for (int i = 0; i < sizes[l]; i++) {
+      float value = max(-1.0f, min(1.0f, layers[l][i]));
+      float y = HEIGHT - 10.0f - (i + 1) * row_h;
+      if (l == 2 && i < BEHAVIOR_COUNT && (record.fired >> i & 1)) {
+        eg_set_color(0.4f, 0.9f, 0.4f, 0.9f);
+      } else {
+        eg_set_color(0.6f, 0.6f, 0.9f, 0.9f);
+      }
+      eg_draw_square(min(x, x + value * bar_w), y + 1.0f, fabsf(value) * bar_w, row_h - 2.0f);
+    }
+  }
+}
+
+// one agent, as it is or as it was at frame at
+void draw_agent(const AgentView &agent, int at) {
+  int age = at - agent.born;
+  bool is_egg = age < incubation_period;
+  bool is_adult = age >= incubation_period + juvenile_period;
+  float health = view_health(agent, at);
+
+  // pixel location
+  int x, y;
+  axial_to_xy(agent.q, agent.r, x, y);
+
+  float r, g, b;
+  hsv_to_rgb(agent.hue, 1.0f, 1.0f, &r, &g, &b);
+
+  // indicate orientation
+  if (!is_egg) {
+      eg_set_color(r, g, b, 1.0f);
+      float angle = agent.orientation / 6.0f * 2 * M_PI + (M_PI / 6.0f);
+      float orientation_line_length = 25.0;
+      eg_draw_line(x, 
+                   y, 
+                   x + (float)cos(angle) * orientation_line_length,
+                   y + (float)sin(angle) * orientation_line_length,
+                   15.0f);
+  }
+
+  // agent
+  eg_push_transform();
+  eg_translate(x, y);
+  eg_rotate((agent.orientation / 6.0f) * 360.0f + (360 / 12));
+  float buddy_size = 20.0f;
+  if (!is_adult)
+      buddy_size *= 0.6f;
+  eg_scale(buddy_size, buddy_size);
+  if (is_adult)
+      eg_set_color(0.9f, 0.9f, 0.9f, 1.0f);
+  else
+      eg_set_color(r, g, b, 1.0f);
+  eg_draw_square(-0.5f, -0.5f, 1.0f, 1.0f);
+  eg_scale(0.5f, 0.5f);
+  eg_set_color(0.0f, 0.0f, 0.0f, 1.0f);
+  eg_draw_square(-0.5f, -0.5f, 1.0f, 1.0f);
+  eg_pop_transform();
+
+  if (draw_extra_info) {
+    // health bar
+    eg_set_color(0.2f, 0.2f, 0.2f, 0.7f);
+    eg_draw_square(x - 15.0f, y + 12.0f, 30.0f, 5.0f);
+    if (health > max_hp * 0.25f) {
+      eg_set_color(0.5f, 0.9f, 0.5f, 0.8f);
+    } else {
+      eg_set_color(0.8f, 0.3f, 0.3f, 0.8f);
+    }
+    eg_draw_square(x - 15.0f, y + 12.0f, health * 30.0f / max_hp, 5.0f);
+  }
+}
+
+void draw() {
+  eg_clear_screen(0.0f, 0.0f, 0.0f, 0.0f);
+  eg_reset_transform();
+
+  if (draw_record % 6 == 0) {
+    const WorldView *past = scrub_frame >= 0 ? &scrub_view : 0;
+
+    if (moving) {
+      int mouse_x, mouse_y;
+      SDL_GetMouseState(&mouse_x, &mouse_y);
+      mouse_y = HEIGHT - mouse_y;
+      camera_x -= (float)(mouse_x - moving_home_x) * (1.0f / camera_zoom);
+      camera_y -= (float)(mouse_y - moving_home_y) * (1.0f / camera_zoom);
+      moving_home_x = mouse_x;
+      moving_home_y = mouse_y;
+    }
+
+    if (zooming) {
+      int mouse_x, mouse_y;
+      SDL_GetMouseState(&mouse_x, &mouse_y);
+      mouse_y = HEIGHT - mouse_y;
+      camera_zoom = max(0.001f, camera_zoom + (float)(mouse_y - zooming_home) * 0.003f);
+      zooming_home = mouse_y;
+    }
+
+    // the live view stops following an agent once it has died
+    if (following && !past && agents.get(following) == 0) {
+      following = 0;
+      print_following();
+    }
+    if (following) {
+      int x, y;
+      if (past) {
+        const AgentView &agent = past->agents[AgentPool<Agent>::index_of(following)];
+        axial_to_xy(agent.q, agent.r, x, y);
+      } else {
+        const Agent &agent = *agents.get(following);
+        axial_to_xy(agent.q, agent.r, x, y);
+      }
+      camera_x = x;
+      camera_y = y;
+    }
+
+    eg_scale(camera_zoom, camera_zoom);
+    eg_translate(-camera_x, -camera_y);
+    eg_translate((float)(WIDTH / 2) / camera_zoom,
+                 (float)(HEIGHT / 2) / camera_zoom);
+
+    // far out, the heatmap; otherwise only the hexes and agents on screen
+    if (HEX_SIZE * camera_zoom < HEATMAP_HEX_PIXELS) {
+      draw_heatmap(past);
+    } else {
+      Viewport viewport(camera_x, camera_y, camera_zoom);
+      for (int q = viewport.q0; q < viewport.q1; q++) {
+        int r0, r1;
+        viewport.rows(q, r0, r1);
+        for (int r = r0; r < r1; r++) {
+          WorldHex *hex = hex_axial(q, r);
+          char food = past ? past->food[hex - world] : hex->food;
+
+          eg_push_transform();
+          int x, y;
+          axial_to_xy(q, r, x, y);
+          eg_translate(x, y);
+          eg_scale(HEX_SIZE * 0.94F, HEX_SIZE * 0.94F);
+
+          if (!(food & 1))
+            eg_set_color(0.1f, 0.2f, 0.05f, 1.0f);
+          else
+            eg_set_color(0.05f, 0.3f, 0.05f, 1.0f);
+        
+          glBegin(GL_POLYGON);
+          glVertex2f(sin((M_PI * 1.5f) / 3.0f), cos((M_PI * 1.5f) / 3.0f));
+          glVertex2f(sin((M_PI * 2.5f) / 3.0f), cos((M_PI * 2.5f) / 3.0f));
+          glVertex2f(sin((M_PI * 3.5f) / 3.0f), cos((M_PI * 3.5f) / 3.0f));
+          glVertex2f(sin((M_PI * 4.5f) / 3.0f), cos((M_PI * 4.5f) / 3.0f));
+          glVertex2f(sin((M_PI * 5.5f) / 3.0f), cos((M_PI * 5.5f) / 3.0f));
+          glVertex2f(sin((M_PI * 6.5f) / 3.0f), cos((M_PI * 6.5f) / 3.0f));
+          glEnd();          
+        
+          if (food & 2) { 
+            eg_scale(.4f, .4f);
+            eg_set_color(0.7f, 0.0f, 0.1f, 1.0f);
+            glBegin(GL_POLYGON);
+            glVertex2f(sin((2 * M_PI * 1.0f) / 3.0f), cos((2 * M_PI * 1.0f) / 3.0f));
+            glVertex2f(sin((2 * M_PI * 2.0f) / 3.0f), cos((2 * M_PI * 2.0f) / 3.0f));
+            glVertex2f(sin((2 * M_PI * 3.0f) / 3.0f), cos((2 * M_PI * 3.0f) / 3.0f));
+            glEnd();
+            eg_pop_transform();
+          }
+        
+          eg_pop_transform();
+        }
+      }
+
+      // draw agents, as they are or as they were at the scrubbed frame: the
+      // live world finds them on the hexes in view, and a scrubbed view,
+      // which keeps no hex map, walks every slot, parked ones among them
+      if (past) {
+        for (int i = 0; i < (int)past->agents.size(); i++) {
+          const AgentView &agent = past->agents[i];
+          if (!agent.out && viewport.contains(agent.q, agent.r)) {
+            draw_agent(agent, past->frame);
+          }
+        }
+      } else {
+        for (int q = viewport.q0; q < viewport.q1; q++) {
+          int r0, r1;
+          viewport.rows(q, r0, r1);
+          for (int r = r0; r < r1; r++) {
+            if (const Agent *agent = agents.get(hex_axial(q, r)->agent)) {
+              draw_agent(view_of(*agent), frame);
+            }
+          }
+        }
+      }
+    }
+
+    eg_reset_transform();
+    draw_trace(past ? past->frame : frame);
+  }
+
+  // gene graph
+  if (draw_record % 6 == 1) {
+    float interval_h = HEIGHT / (float)DNA_SIZE;
+    for (int rx = 0; rx < WIDTH; rx++) {
+      const Record &record = records[(records_index + rx) % WIDTH];
+      if (record.genome < 0) {
+        continue;
+      }
+      float dna[DNA_SIZE];
+      for (int wi = 0; wi < DNA_SIZE; wi++) {
+        dna[wi] = genome_pool.get(record.genome, wi);
+      }
+      float mx = 0.0f;
+      for (int wi = 0; wi < DNA_SIZE; wi++) {
+        mx = fmax(mx, dna[wi]);
+      }
+      float y = 0.0f;
+      for (int wi = 0; wi < DNA_SIZE; wi++) {
+        float r, g, b;
+        hsv_to_rgb(record.selected_hue, 1.0, 1.0, &r, &g, &b);
+        eg_set_color(r, g, b, 1.0f);
+        float h = (fabs(dna[wi]) / mx) * interval_h;
+        eg_draw_line(rx, y, rx, y + h, 1.5f);
+        y += interval_h;
+      }
+    }
+  }
+
+  // total score graph
+  if (draw_record % 6 == 2) {
+    for (int rx = 0; rx < WIDTH; rx++) {
+      const Record &record = records[(records_index + rx) % WIDTH];
+      for (size_t i = 0; i < record.outs.size(); ++i) {
+        if (!record.outs[i]) {
+          float r, g, b;
+          hsv_to_rgb(record.hues[i], 1.00f, 1.00f, &r, &g, &b);
+          eg_set_color(r, g, b, 1.0f);
+          eg_draw_square(rx, record.scores[i] % HEIGHT, 1.0f, 1.0f);
+        }
+      }
+    }
+  }
+
+  // population graph
+  if (draw_record % 6 == 3) {
+    for (int rx = 0; rx < WIDTH; rx++) {
+      const Record &record = records[(records_index + rx) % WIDTH];
+      float h = (float)HEIGHT / (float)max((int)record.outs.size(), 1);
+      float y = 0;
+      for (size_t i = 0; i < record.outs.size(); ++i) {
+        float r, g, b;
+        hsv_to_rgb(record.hues[i], 1.00f, record.outs[i] ? 0.0f : 1.0f, &r, &g, &b);
+        eg_set_color(r, g, b, 1.0f);
+        eg_draw_line(rx, y, rx, y + h, 1.0f);
+        y += h;
+      }
+    }
+  }
+
+  // species graph
+  if (draw_record % 6 == 4) {
+    float h = (float)HEIGHT / (float)num_agents;
+    for (int rx = 0; rx < WIDTH; rx++) {
+      const Record &record = records[(records_index + rx) % WIDTH];
+      float y = 0;
+      for (int s = 0; s < Species::MAX_SPECIES; ++s) {
+        if (record.species_sizes[s] == 0) {
+          continue;
+        }
+        float r, g, b;
+        hsv_to_rgb(record.species_hues[s], 1.00f, 1.00f, &r, &g, &b);
+        eg_set_color(r, g, b, 1.0f);
+        eg_draw_line(rx, y, rx, y + h * record.species_sizes[s], 1.0f);
+        y += h * record.species_sizes[s];
+      }
+    }
+  }
+
+  // stats graph, one column per frame: live agents in white, mean and best
+  // score in green, mean and greatest age in blue
+  if (draw_record % 6 == 5) {
+    int top_score = 1, top_age = 1;
+    for (int rx = 0; rx < WIDTH; rx++) {
+      top_score = max(top_score, stats_history[rx].max_score);
+      top_age = max(top_age, stats_history[rx].max_age);
+    }
+    float live_h = (float)HEIGHT / (float)max(num_agents, 1);
+    float score_h = (float)HEIGHT / (float)top_score;
+    float age_h = (float)HEIGHT / (float)top_age;
+    for (int rx = 0; rx < WIDTH; rx++) {
+      const StatsSnapshot &s = stats_history[(frame + 1 + rx) % WIDTH];
+      eg_set_color(0.9f, 0.9f, 0.9f, 1.0f);
+      eg_draw_square(rx, s.live * live_h, 1.0f, 1.0f);
+      eg_set_color(0.2f, 0.5f, 0.2f, 1.0f);
+      eg_draw_square(rx, s.mean_score * score_h, 1.0f, 1.0f);
+      eg_set_color(0.4f, 0.9f, 0.4f, 1.0f);
+      eg_draw_square(rx, s.max_score * score_h, 1.0f, 1.0f);
+      eg_set_color(0.2f, 0.2f, 0.6f, 1.0f);
+      eg_draw_square(rx, s.mean_age * age_h, 1.0f, 1.0f);
+      eg_set_color(0.4f, 0.4f, 0.9f, 1.0f);
+      eg_draw_square(rx, s.max_age * age_h, 1.0f, 1.0f);
+    }
+  }
+
+  eg_swap_buffers();
+}
+
+void step() {
+
+  // handle user events
+  EGEvent event;
+  while (!headless && eg_poll_event(&event)) {
+    switch (event.type) {
+    case SDL_QUIT: {
+      quit = true;
+      break;
+    }
+    case SDL_MOUSEBUTTONDOWN: {
+      SDL_MouseButtonEvent e = event.button;
+      break;
+    }
+    case SDL_KEYDOWN: {
+      SDL_KeyboardEvent e = event.key;
+      switch (e.keysym.scancode) {
+      case SDL_SCANCODE_GRAVE:
+        frame_rate = 1;
+        if (paused)
+          nudge = true;
+        else
+          paused = true;
+        break;
+      case SDL_SCANCODE_1:
+        frame_rate = 1;
+        paused = false;
+        break;
+      case SDL_SCANCODE_2:
+        frame_rate = int((float)turbo_rate * 0.04f);
+        paused = false;
+        break;
+      case SDL_SCANCODE_3:
+        frame_rate = int((float)turbo_rate * 0.20f);
         paused = false;
         break;
       case SDL_SCANCODE_4:
@@ -525,25 +1577,26 @@ void step() {
         nudge = true;
         break;
       case SDL_SCANCODE_LEFTBRACKET:
-        --following;
-        if (following < 0)
-          following = num_agents - 1;
-        printf("following=%d\n", following);
+        follow_next(-1);
         break;
       case SDL_SCANCODE_RIGHTBRACKET:
-        ++following;
-        if (following >= num_agents)
-          following = 0;
-        printf("following=%d\n", following);
+        follow_next(+1);
+        break;
+      case SDL_SCANCODE_T:
+        if (e.keysym.mod & KMOD_SHIFT) {
+          dump_trace();
+        } else {
+          toggle_trace();
+        }
+        nudge = true;
         break;
       case SDL_SCANCODE_I:
         draw_extra_info = !draw_extra_info;
         nudge = true;
         break;
       case SDL_SCANCODE_C:
-        for (int i = 0; i < WORLD_SIZE; i++) {
-          world[i].food = 0;
-        }
+        clear_food();
+        journal.clear(frame);
         nudge = true;
         break;
       case SDL_SCANCODE_SPACE:
@@ -553,9 +1606,15 @@ void step() {
           moving_home_x = mouse_x;
           moving_home_y = HEIGHT - mouse_y;
           moving = true;
-          following = -1;
+          following = 0;
         }
         break;
+      case SDL_SCANCODE_COMMA:
+      case SDL_SCANCODE_PERIOD: {
+        int frames = (e.keysym.mod & KMOD_SHIFT) ? SCRUB_STEP * 10 : SCRUB_STEP;
+        scrub(e.keysym.scancode == SDL_SCANCODE_COMMA ? -frames : frames);
+        break;
+      }
       case SDL_SCANCODE_Z:
         if (e.repeat == 0) {
           int mouse_x, mouse_y;
@@ -585,355 +1644,355 @@ void step() {
     }
   }
 
-  if (paused && !nudge)
+  JournalEntry entry;
+  while (replayed(JOURNAL_CLEAR, entry)) {
+    clear_food();
+  }
+
+  if (paused && !nudge) {
+    if (!headless && (redraw || moving || zooming)) {
+      draw();
+    }
+    redraw = false;
     return;
+  }
   nudge = false;
+  scrub_frame = -1;
+  phase_start = steady_clock::now();
   
   long now = system_clock::now().time_since_epoch().count();
-  if (now - last_refresh > last_refresh_interval) {
+  if (replaying) {
+    while (replayed(JOURNAL_CONFIG, entry)) {
+      apply_parameters(entry.parameters);
+    }
+  } else if (now - last_refresh > last_refresh_interval) {
     refreshConfig();
     last_refresh = now;
   }
   
-  if (fdis(gen) < agent_spawn_rate) {
-    for (int i = 0; i < num_agents; i++) {
-      Agent &agent = agents[i];
-      if (agent.out) {
-        agent.randomize();
-        agent.reset_agent();
-        break;
-      }
+  if (frame == 0) {
+    seed_world();
+  }
+
+  if (rng.uniform() < agent_spawn_rate) {
+    Agent *agent = vacancy();
+    if (agent != 0) {
+      conceive(*agent);
+      place_newcomer(*agent);
     }
   }
 
+  if (archipelago.size() > 1 && frame % migration_interval == 0 && frame > 0) {
+    migrate();
+  }
+  welcome_migrants();
+
   // grow food
-  if (fdis(gen) < food_spawn_rate) {
-    world[(int)(fdis(gen) * WORLD_SIZE)].food |= 1;
+  if (rng.uniform() < food_spawn_rate) {
+    int i = (int)(rng.uniform() * WORLD_SIZE);
+    world[i].food |= 1;
+    timeline.food(frame, i, world[i].food);
   }
+  end_phase(PHASE_WORLD);
 
-  // behavior model
-  for (int i = 0; i < num_agents; i++) {
+  // behavior model, for the agents due this frame
+  static std::vector<Scheduler::Entry> due;
+  scheduler.due(frame, due);
+  for (size_t d = 0; d < due.size(); d++) {
 
-    Agent &agent = agents[i];
+    if (!scheduler.is_current(due[d])) {
+      continue;
+    }
+    Agent &agent = agents[due[d].agent];
 
     // out
     if (agent.out) {
       continue;
     }
-    
-    // age
-    agent.age++;
 
-    // health decay
-    if (! agent.is_egg()) {
-        agent.health_points -= burn_rate;
-    }
-    
-    // waiting
-    if (agent.waiting > 0) {
-      agent.waiting--;
+    // parked above num_agents, off the wheel until apply_parameters()
+    // raises it past them
+    if (due[d].agent >= num_agents) {
       continue;
     }
+    
+    // age and health decay
+    agent.settle();
 
     // death
     if (agent.health_points <= 0.0f) {
-      remove_from_world(agent);
+      remove_from_world(agent, DEATH_STARVATION);
       continue;
     }
     
-    // eggs have no brain
-    if (agent.is_egg()) {
-        continue;
+    // eggs have no brain, and waiting agents do not act
+    if (agent.is_egg() || frame < agent.next_action) {
+      schedule_agent(agent);
+      continue;
     }
+    agent.waiting = 0;
     
     // NN
     
-    FoodSensor foodSensor_here(0, 0);
-    FoodSensor foodSensor_ahead1(0, 1);
-    FoodSensor foodSensor_ahead2(0, 2);
-    FoodSensor foodSensor_ahead3(0, 3);
-    FoodSensor foodSensor_left1(1, 1);
-    FoodSensor foodSensor_left2(1, 2);
-    FoodSensor foodSensor_right1(-1, 1);
-    FoodSensor foodSensor_right2(-1, 2);
-    AgentSensor agentSensor_ahead1(0, 1);
-    SelfHealthPointsSensor selfHealthPointsSensor;
-    
-    float input1 = foodSensor_here.sense(agent);
-    float input2 = foodSensor_ahead1.sense(agent);
-    float input3 = foodSensor_ahead2.sense(agent);
-    float input4 = foodSensor_ahead3.sense(agent); 
-    float input5 = foodSensor_left1.sense(agent);
-    float input6 = foodSensor_left2.sense(agent); 
-    float input7 = foodSensor_right1.sense(agent);
-    float input8 = foodSensor_right2.sense(agent); 
-    float input9 = selfHealthPointsSensor.sense(agent); 
-    float input10 = agent.memory[0];
-    float input11 = agent.memory[1];
-    float input12 = agent.memory[2];
-    float input13 = agent.memory[3];
-    float inputs[13] = { input1, input2, input3, input4, input5, input6, input7, input8, input9, input10, input11, input12, input13 };
-    
-    float hidden[8] = { };
-    float *weights = agent.dna;
-    invoke_nn(13, inputs, 8, hidden, weights);
-    weights += 13 * 8;
-    float outputs[9] = { };
-    invoke_nn(8, hidden, 9, outputs, weights);
-    
-    RotationalBehavior rotationalBehavior;
-    LinearBehavior linearBehavior;
-    KillBehavior killBehavior;
-    EatingBehavior eatingBehavior;
-    SpawningBehavior spawningBehavior;
-    
-    weights += (13 * 8 + 8 * 9);  
-    
-    if (outputs[0] > *weights++) {
-      eatingBehavior.behave(agent, 1.0f);
+    float inputs[Brain::INPUTS];
+    for (int s = 0; s < SENSOR_COUNT; s++) {
+      inputs[s] = sense(senses.sensors[s], agent);
     }
-    
-    if (outputs[1] > *weights++) {
-      linearBehavior.behave(agent, 1.0f);
+    for (int m = 0; m < MEMORY_SIZE; m++) {
+      inputs[SENSOR_COUNT + m] = agent.memory[m];
     }
-    
-    if (outputs[2] > *weights++) {
-      killBehavior.behave(agent, 1.0f);
+
+    float hidden[HIDDEN_SIZE];
+    float outputs[Brain::OUTPUTS];
+    const AgentGenome &dna = genome_pool.expanded(agent.genome);
+    forward_as(activation, dna, inputs, hidden, outputs);
+    float gains[Brain::OUTPUTS];
+    dna.gains(gains);
+
+    if (tracer.active()) {
+      trace_decision(agent, inputs, hidden, outputs, gains);
     }
-    
-    rotationalBehavior.behave(agent, outputs[3] * *weights++);
-    
-    if (outputs[4] > *weights++) {
-      spawningBehavior.behave(agent, 1.0f);
+
+    // a turn scales its output by its gain; the rest fire above it
+    for (int b = 0; b < BEHAVIOR_COUNT; b++) {
+      switch (senses.behaviors[b]) {
+      case BEHAVE_TURN:
+        behave_turn(agent, outputs[b] * gains[b]);
+        break;
+      case BEHAVE_EAT:
+        if (outputs[b] > gains[b]) {
+          behave_eat(agent);
+        }
+        break;
+      case BEHAVE_MOVE:
+        if (outputs[b] > gains[b]) {
+          behave_move(agent);
+        }
+        break;
+      case BEHAVE_KILL:
+        if (outputs[b] > gains[b]) {
+          behave_kill(agent);
+        }
+        break;
+      case BEHAVE_SPAWN:
+        if (outputs[b] > gains[b]) {
+          behave_spawn(agent);
+        }
+        break;
+      }
     }
-    
-    agent.memory[0] = outputs[5] * *weights++;
-    agent.memory[1] = outputs[6] * *weights++;
-    agent.memory[2] = outputs[7] * *weights++;
-    agent.memory[3] = outputs[8] * *weights++;
-    
-    assert(weights = agent.dna + DNA_SIZE);
+
+    for (int m = 0; m < MEMORY_SIZE; m++) {
+      agent.memory[m] = outputs[BEHAVIOR_COUNT + m] * gains[BEHAVIOR_COUNT + m];
+    }
+
+    agent.next_action = frame + agent.waiting + 1;
+    timeline.turn(frame, due[d].agent, agent.q, agent.r, agent.orientation, agent.health_points);
+    schedule_agent(agent);
+  }
+  end_phase(PHASE_AGENTS);
+      
+  stats_history[frame % WIDTH] = stats.snapshot(frame);
+
+  if (timeline.keyframe_due(frame)) {
+    keyframe();
+  }
+
+  if (frame % SPECIES_RATE == 0) {
+    recenter_species();
   }
       
   // update record model
   if (frame % RECORD_SAMPLE_RATE == 0 && num_agents > 0) {
-    int selected_index = select();
+    int selected_index = select(rng);
+    if (!agents[selected_index].out) {
+      bank.append(bank_record(agents[selected_index]));
+    }
     records[records_index].selected_hue = agents[selected_index].hue;
-    for (int i = 0; i < DNA_SIZE; i++) {
-      records[records_index].dna[i] = agents[selected_index].dna[i];
+    Record &record = records[records_index];
+    genome_pool.release(record.genome);
+    record.genome = agents[selected_index].genome;
+    if (record.genome >= 0) {
+      genome_pool.retain(record.genome);
     }
-    for (int i = 0; i < max_agents; i++) {
-      const Agent &agent = agents[i];
-      records[records_index].scores[i] = agent.score;
-      records[records_index].hues[i] = agent.hue;
-      records[records_index].outs[i] = agent.out;
+    record.distinct_genomes = genome_pool.distinct();
+    record.species_count = species.count();
+    for (int s = 0; s < Species::MAX_SPECIES; s++) {
+      record.species_sizes[s] = species.size(s);
+      record.species_hues[s] = species.hue(s);
+    }
+    int stride = (num_agents + RECORD_AGENTS - 1) / RECORD_AGENTS;
+    int sampled = (num_agents + stride - 1) / stride;
+    record.scores.resize(sampled);
+    record.hues.resize(sampled);
+    record.outs.resize(sampled);
+    for (int i = 0; i < sampled; i++) {
+      const Agent &agent = agents[i * stride];
+      record.scores[i] = agent.score;
+      record.hues[i] = agent.hue;
+      record.outs[i] = agent.out;
     }
     records_index++;
     records_index %= WIDTH;
   }
+  end_phase(PHASE_RECORD);
 
   // display
-  if (frame % frame_rate == 0 || moving || zooming) {
-
-    eg_clear_screen(0.0f, 0.0f, 0.0f, 0.0f);
-    eg_reset_transform();
-
-    if (draw_record % 4 == 0) {
-
-      if (moving) {
-        int mouse_x, mouse_y;
-        SDL_GetMouseState(&mouse_x, &mouse_y);
-        mouse_y = HEIGHT - mouse_y;
-        camera_x -= (float)(mouse_x - moving_home_x) * (1.0f / camera_zoom);
-        camera_y -= (float)(mouse_y - moving_home_y) * (1.0f / camera_zoom);
-        moving_home_x = mouse_x;
-        moving_home_y = mouse_y;
-      }
-
-      if (zooming) {
-        int mouse_x, mouse_y;
-        SDL_GetMouseState(&mouse_x, &mouse_y);
-        mouse_y = HEIGHT - mouse_y;
-        camera_zoom += (float)(mouse_y - zooming_home) * 0.003f;
-        zooming_home = mouse_y;
-      }
-
-      if (following != -1) {
-        int x, y;
-        axial_to_xy(agents[following].q, agents[following].r, x, y);
-        camera_x = x;
-        camera_y = y;
-      }
-
-      eg_scale(camera_zoom, camera_zoom);
-      eg_translate(-camera_x, -camera_y);
-      eg_translate((float)(WIDTH / 2) / camera_zoom,
-                   (float)(HEIGHT / 2) / camera_zoom);
-
-      for (int q = 0; q < Q; q++) {
-        for (int r = 0; r < R; r++) {
-          WorldHex *hex = hex_axial(q, r);
+  if (!headless && (frame % frame_rate == 0 || moving || zooming)) {
+    draw();
+  }
+  end_phase(PHASE_DISPLAY);
+
+  if (frame % JournalWriter::CHECK_INTERVAL == 0) {
+    if (!replaying) {
+      journal.check(frame, world_hash());
+    } else if (replayed(JOURNAL_CHECK, entry) && entry.hash != world_hash()) {
+      printf("replay: off the journaled path by frame %d\n", frame);
+      replaying = false;
+    }
+  }
 
-          eg_push_transform();
-          int x, y;
-          axial_to_xy(q, r, x, y);
-          eg_translate(x, y);
-          eg_scale(HEX_SIZE * 0.94F, HEX_SIZE * 0.94F);
+  publish_monitor();
+  frame++;
+}
 
-          if (!(hex->food & 1))
-            eg_set_color(0.1f, 0.2f, 0.05f, 1.0f);
-          else
-            eg_set_color(0.05f, 0.3f, 0.05f, 1.0f);
-          
-          glBegin(GL_POLYGON);
-          glVertex2f(sin((M_PI * 1.5f) / 3.0f), cos((M_PI * 1.5f) / 3.0f));
-          glVertex2f(sin((M_PI * 2.5f) / 3.0f), cos((M_PI * 2.5f) / 3.0f));
-          glVertex2f(sin((M_PI * 3.5f) / 3.0f), cos((M_PI * 3.5f) / 3.0f));
-          glVertex2f(sin((M_PI * 4.5f) / 3.0f), cos((M_PI * 4.5f) / 3.0f));
-          glVertex2f(sin((M_PI * 5.5f) / 3.0f), cos((M_PI * 5.5f) / 3.0f));
-          glVertex2f(sin((M_PI * 6.5f) / 3.0f), cos((M_PI * 6.5f) / 3.0f));
-          glEnd();          
-          
-          if (hex->food & 2) { 
-            eg_scale(.4f, .4f);
-            eg_set_color(0.7f, 0.0f, 0.1f, 1.0f);
-            glBegin(GL_POLYGON);
-            glVertex2f(sin((2 * M_PI * 1.0f) / 3.0f), cos((2 * M_PI * 1.0f) / 3.0f));
-            glVertex2f(sin((2 * M_PI * 2.0f) / 3.0f), cos((2 * M_PI * 2.0f) / 3.0f));
-            glVertex2f(sin((2 * M_PI * 3.0f) / 3.0f), cos((2 * M_PI * 3.0f) / 3.0f));
-            glEnd();
-            eg_pop_transform();
-          }
-          
-          eg_pop_transform();
-        }
-      }
+void unit_tests();
 
-      // draw agents
-      for (int i = 0; i < num_agents; i++) {
-        Agent agent = agents[i];
-        if (agent.out) {
-          continue;
-        }
+void print_summary() {
+  if (archipelago.size() > 1) {
+    printf("island=%d\n", archipelago.island());
+  }
+  printf("frames=%'d\ndays=%'d\nyears=%'d\n", frame, frame / DAY_LENGTH, frame / DAY_LENGTH / 365);
+  printf("genomes=%'d\n", genome_pool.distinct());
+  printf("species=%'d\n", species.count());
+  printf("births=%'llu\ndeaths=%'llu\n", (unsigned long long)lineage.births(), (unsigned long long)lineage.deaths());
+  StatsSnapshot totals = stats.snapshot(frame);
+  printf("starved=%'llu\nkilled=%'llu\nmeals=%'llu\nmoves=%'llu/%'llu\nspawns=%'llu/%'llu\n",
+         (unsigned long long)totals.deaths[DEATH_STARVATION], (unsigned long long)totals.deaths[DEATH_KILLED],
+         (unsigned long long)totals.meals, (unsigned long long)totals.moves, (unsigned long long)totals.moves_attempted,
+         (unsigned long long)totals.spawns, (unsigned long long)totals.spawns_attempted);
+  if (archipelago.size() > 1) {
+    printf("emigrants=%'llu\nimmigrants=%'llu\n", (unsigned long long)emigrants, (unsigned long long)immigrants);
+  }
+  fflush(stdout);
+}
 
-        // pixel location
-        int x, y;
-        axial_to_xy(agent.q, agent.r, x, y);
-        
-        float r, g, b;
-        hsv_to_rgb(agent.hue, 1.0f, 1.0f, &r, &g, &b);
-
-        // indicate orientation
-        if (!agent.is_egg()) {
-            eg_set_color(r, g, b, 1.0f);
-            float angle = agent.orientation / 6.0f * 2 * M_PI + (M_PI / 6.0f);
-            float orientation_line_length = 25.0;
-            eg_draw_line(x, 
-                         y, 
-                         x + (float)cos(angle) * orientation_line_length,
-                         y + (float)sin(angle) * orientation_line_length,
-                         15.0f);
-        }
+// the seed and the parameters the run starts under come first
+void open_journal(const std::string &path) {
+  journal.open(path, seed, archipelago.island(), seeds.size(), senses);
+  journal.config(frame, current_parameters());
+}
 
-        // agent
-        eg_push_transform();
-        eg_translate(x, y);
-        eg_rotate((agent.orientation / 6.0f) * 360.0f + (360 / 12));
-        float buddy_size = 20.0f;
-        if (!agent.is_adult())
-            buddy_size *= 0.6f;
-        eg_scale(buddy_size, buddy_size);
-        if (agent.is_adult())
-            eg_set_color(0.9f, 0.9f, 0.9f, 1.0f);
-        else
-            eg_set_color(r, g, b, 1.0f);
-        eg_draw_square(-0.5f, -0.5f, 1.0f, 1.0f);
-        eg_scale(0.5f, 0.5f);
-        eg_set_color(0.0f, 0.0f, 0.0f, 1.0f);
-        eg_draw_square(-0.5f, -0.5f, 1.0f, 1.0f);
-        eg_pop_transform();
-
-        if (draw_extra_info) {
-          // health bar
-          eg_set_color(0.2f, 0.2f, 0.2f, 0.7f);
-          eg_draw_square(x - 15.0f, y + 12.0f, 30.0f, 5.0f);
-          if (agent.health_points > max_hp * 0.25f) {
-            eg_set_color(0.5f, 0.9f, 0.5f, 0.8f);
-          } else {
-            eg_set_color(0.8f, 0.3f, 0.3f, 0.8f);
-          }
-          eg_draw_square(x - 15.0f, y + 12.0f, agent.health_points * 30.0f / max_hp, 5.0f);
-        }
-      }
-    }
+// Opened before any island forks: every island appends to the one genome
+// bank and draws from the one mapping of the seed bank.
+void open_banks() {
+  if (!genome_bank.empty()) {
+    bank.open(genome_bank, senses);
+  }
+  if (!seed_bank.empty() && seeds.open(seed_bank, senses.signature())) {
+    printf("seed_bank=%s genomes=%d\n", seed_bank.c_str(), seeds.size());
+  }
+}
 
-    // gene graph
-    if (draw_record % 4 == 1) {
-      float interval_h = HEIGHT / (float)DNA_SIZE;
-      for (int rx = 0; rx < WIDTH; rx++) {
-        const Record &record = records[(records_index + rx) % WIDTH];
-        float mx = 0.0f;
-        for (int wi = 0; wi < DNA_SIZE; wi++) {
-          mx = fmax(mx, record.dna[wi]);
-        }
-        float y = 0.0f;
-        for (int wi = 0; wi < DNA_SIZE; wi++) {
-          float r, g, b;
-          hsv_to_rgb(record.selected_hue, 1.0, 1.0, &r, &g, &b);
-          eg_set_color(r, g, b, 1.0f);
-          float h = (fabs(record.dna[wi]) / mx) * interval_h;
-          eg_draw_line(rx, y, rx, y + h, 1.5f);
-          y += interval_h;
-        }
-      }
-    }
+// Every island after the first runs here, headless, until any island quits.
+// Each keeps its own lineage files and monitor segment.
+void run_island() {
+  headless = true;
+  seed = ((uint64_t)rd() << 32 | rd()) + archipelago.island();
+  rng = Random(seed);
+  lineage.rename("lineage-" + std::to_string(archipelago.island()));
+  open_journal("journal-" + std::to_string(archipelago.island()));
+  monitor.open(monitor_name(getpid()));
+  while (!archipelago.quitting()) {
+    step();
+  }
+  journal.end(frame, world_hash());
+  bank_survivors();
+  print_summary();
+  lineage.flush();
+  monitor.close();
+}
 
-    // total score graph
-    if (draw_record % 4 == 2) {
-      for (int rx = 0; rx < WIDTH; rx++) {
-        const Record &record = records[(records_index + rx) % WIDTH];
-        for (int i = 0; i < max_agents; ++i) {
-          if (!record.outs[i]) {
-            float r, g, b;
-            hsv_to_rgb(record.hues[i], 1.00f, 1.00f, &r, &g, &b);
-            eg_set_color(r, g, b, 1.0f);
-            eg_draw_square(rx, record.scores[i] % HEIGHT, 1.0f, 1.0f);
-          }
-        }
-      }
+// Runs a journaled run again, headless and as fast as it will go, up to the
+// frame it ended on, or its last check if it never did. Its lineage is kept
+// beside the journal.
+int replay(const char *path) {
+  if (!replay_journal.open(path)) {
+    return 1;
+  }
+  headless = true;
+  // settings read only at startup, the seed bank among them, come from
+  // config as they did for the run; the journal sets the rest, and wires
+  // the agents as the run did
+  refreshConfig();
+  senses = replay_journal.senses();
+  if (!seed_bank.empty()) {
+    seeds.open(seed_bank, senses.signature());
+  }
+  // runs append to the genome bank, which may be the seed bank too
+  if (seeds.size() < replay_journal.seed_records()) {
+    printf("replay: the run drew from %d seed genomes, and %s holds %d\n",
+           replay_journal.seed_records(), seed_bank.c_str(), seeds.size());
+    return 1;
+  }
+  seeds.limit(replay_journal.seed_records());
+  replaying = true;
+  seed = replay_journal.seed();
+  rng = Random(seed);
+  lineage.rename(std::string(path) + ".lineage");
+  monitor.open(monitor_name(getpid()));
+  steady_clock::time_point start = steady_clock::now();
+  bool ok = true;
+  while (const JournalEntry *next = replay_journal.peek()) {
+    if (next->frame < frame || !replaying) {
+      ok = false;
+      break;
     }
-
-    // population graph
-    if (draw_record % 4 == 3) {
-      float h = (float)HEIGHT / (float)num_agents;
-      for (int rx = 0; rx < WIDTH; rx++) {
-        const Record &record = records[(records_index + rx) % WIDTH];
-        float y = 0;
-        for (int i = 0; i < num_agents; ++i) {
-          float r, g, b;
-          hsv_to_rgb(record.hues[i], 1.00f, record.outs[i] ? 0.0f : 1.0f, &r, &g, &b);
-          eg_set_color(r, g, b, 1.0f);
-          eg_draw_line(rx, y, rx, y + h, 1.0f);
-          y += h;
-        }
-      }
+    if (next->kind == JOURNAL_END && next->frame == frame) {
+      ok = next->hash == world_hash();
+      break;
     }
-
-    eg_swap_buffers();
+    step();
   }
-
-  frame++;
+  double seconds = duration_cast<milliseconds>(steady_clock::now() - start).count() / 1000.0;
+  print_summary();
+  printf("replay=%s\nreplay_seconds=%.1f\n", ok ? "ok" : "diverged", seconds);
+  lineage.flush();
+  monitor.close();
+  return ok ? 0 : 1;
 }
 
-void unit_tests();
-
 int main(int argc, char *argv[]) {
   unit_tests();
+  if (argc == 3 && strcmp(argv[1], "--replay") == 0) {
+    return replay(argv[2]);
+  }
+  if (argc > 1) {
+    printf("usage: patterns [--replay <journal>]\n");
+    return 1;
+  }
+  // the tests drew from rng, so start the run itself from the seed
+  rng = Random(seed);
+  // the number of islands is only read here, before anything has happened
+  refreshConfig();
+  open_banks();
+  archipelago.create(islands);
+  if (archipelago.island() > 0) {
+    run_island();
+    return 0;
+  }
   init();
-  while (!quit) {
+  open_journal("journal");
+  while (!quit && !archipelago.quitting()) {
     step();
   }
-  printf("frames=%'d\ndays=%'d\nyears=%'d\n", frame, frame / DAY_LENGTH, frame / DAY_LENGTH / 365);
+  journal.end(frame, world_hash());
+  bank_survivors();
+  dump_trace();
+  archipelago.join();
+  print_summary();
+  lineage.flush();
+  monitor.close();
   eg_shutdown();
   return 0;
 }
@@ -976,5 +2035,337 @@ void unit_tests() {
   axial_add_direction(q, r, 3);
   axial_add_direction(q, r, 0);
   assert(x == 0 && y == 0 && z == 0 && q == 0 && r == 0);
-  
-}
\ No newline at end of file
+
+  // the unrolled network agrees with the generic node loop
+  float dna[DNA_SIZE];
+  for (int i = 0; i < DNA_SIZE; i++) {
+    dna[i] = rng.normal();
+  }
+  float inputs[Brain::INPUTS];
+  for (int i = 0; i < Brain::INPUTS; i++) {
+    inputs[i] = rng.uniform();
+  }
+  float hidden[HIDDEN_SIZE], outputs[Brain::OUTPUTS];
+  Brain::forward(dna, inputs, hidden, outputs);
+  float expected_hidden[HIDDEN_SIZE], expected_outputs[Brain::OUTPUTS];
+  invoke_nn(Brain::INPUTS, inputs, HIDDEN_SIZE, expected_hidden, dna + Brain::HIDDEN_WEIGHTS_OFFSET);
+  invoke_nn(HIDDEN_SIZE, expected_hidden, Brain::OUTPUTS, expected_outputs, dna + Brain::OUTPUT_WEIGHTS_OFFSET);
+  for (int i = 0; i < Brain::OUTPUTS; i++) {
+    assert(fabs(outputs[i] - expected_outputs[i]) < 1e-6f);
+  }
+  assert(&Brain::gains(dna)[Brain::OUTPUTS - 1] == dna + DNA_SIZE - 1);
+
+  // the cheaper activations stay close to libm
+  TanhTable tanh_table;
+  for (float x = -10.0f; x <= 10.0f; x += 0.0173f) {
+    assert(fabs(tanh_rational(x) - tanh(x)) < 1e-6f);
+    assert(fabs(tanh_table(x) - tanh(x)) < 1e-5f);
+  }
+  assert(activation_named("table") == ACTIVATION_TABLE && activation_named("fast") == -1);
+
+  // reduced precision genomes stay close to the fp32 network
+  Genome<Brain, Half> half_genome;
+  half_genome.assign(dna);
+  half_genome.forward(inputs, hidden, outputs);
+  for (int i = 0; i < Brain::OUTPUTS; i++) {
+    assert(fabs(outputs[i] - expected_outputs[i]) < 0.01f);
+  }
+  Genome<Brain, int8_t> int8_genome;
+  int8_genome.assign(dna);
+  int8_genome.forward(inputs, hidden, outputs);
+  for (int i = 0; i < Brain::OUTPUTS; i++) {
+    assert(fabs(outputs[i] - expected_outputs[i]) < 0.1f);
+  }
+  for (int i = 0; i < DNA_SIZE; i++) {
+    assert(fabs(half_genome.get(i) - dna[i]) <= fabs(dna[i]) * 0.001f + 1e-4f);
+    assert(fabs(int8_genome.get(i) - dna[i]) <= int8_genome.scales[Brain::block_of(i)] * 0.5f);
+  }
+  // an outlier widens its block's scale, and rescale() narrows it again
+  // once it is gone; what was rounded at the wide scale stays rounded
+  float fitted_scale = int8_genome.scales[0];
+  float was = int8_genome.get(0);
+  int8_genome.set(0, 127.0f * fitted_scale * 4.0f);
+  assert(int8_genome.scales[0] > fitted_scale * 3.9f);
+  int8_genome.set(0, was);
+  int8_genome.rescale();
+  assert(int8_genome.scales[0] < fitted_scale * 1.1f && fabs(int8_genome.get(0) - was) <= fitted_scale * 2.5f);
+
+  // growing the agent pool leaves its slots in place, and handles to an
+  // agent that has left no longer resolve once its slot is taken again
+  AgentPool<Agent> pool_of_agents;
+  pool_of_agents.reserve(1);
+  Agent *slot_zero = &pool_of_agents[0];
+  AgentHandle held = pool_of_agents.handle(1);
+  pool_of_agents.reserve(AgentPool<Agent>::CHUNK + 1);
+  assert(&pool_of_agents[0] == slot_zero && pool_of_agents[AgentPool<Agent>::CHUNK].slot == AgentPool<Agent>::CHUNK);
+  assert(pool_of_agents.get(held) == &pool_of_agents[1] && pool_of_agents.get(0) == 0);
+  pool_of_agents.retire(1);
+  assert(pool_of_agents.get(held) == 0 && pool_of_agents.get(pool_of_agents.handle(1)) == &pool_of_agents[1]);
+
+  // genomes are shared, stored as deltas and deduplicated by content
+  GenomePool pool;
+  AgentGenome genome;
+  genome.assign(dna);
+  GenomeId a = pool.acquire(genome);
+  assert(pool.acquire(genome) == a && pool.distinct() == 1);
+  assert(pool.derive(a, 0, 0) == a);
+  GeneEdit edits[2] = { { 3, 0.3f }, { 100, -0.2f } };
+  GenomeId b = pool.derive(a, edits, 2);
+  assert(b != a && pool.distinct() == 2 && pool.dense_count() == 1);
+  GeneEdit undo[1] = { { 3, pool.get(a, 3) } };
+  GenomeId c = pool.derive(b, undo, 1);
+  assert(pool.derive(a, edits + 1, 1) == c && pool.distinct() == 3);
+  genome.set(3, 0.3f);
+  genome.set(100, -0.2f);
+  assert(pool.get(b, 3) == genome.get(3) && pool.get(b, 100) == genome.get(100) && pool.get(b, 4) == pool.get(a, 4));
+  assert(pool.acquire(genome) == b);
+  // holding a delta expands it once, for every holder, in place of its
+  // edits, and letting go packs it back
+  pool.hold(b);
+  pool.hold(b);
+  assert(pool.dense_count() == 2);
+  const AgentGenome &expanded = pool.expanded(b);
+  for (int i = 0; i < DNA_SIZE; i++) {
+    assert(expanded.get(i) == genome.get(i));
+  }
+  assert(pool.derive(b, undo, 1) == c && pool.acquire(genome) == b && pool.get(b, 3) == genome.get(3));
+  pool.let_go(b);
+  pool.let_go(b);
+  assert(pool.dense_count() == 1 && pool.get(b, 100) == genome.get(100) && pool.derive(b, undo, 1) == c);
+  for (int n = 0; n < 3; n++) {
+    pool.release(a);
+  }
+  assert(pool.distinct() == 3);
+  for (int n = 0; n < 4; n++) {
+    pool.release(c);
+  }
+  for (int n = 0; n < 3; n++) {
+    pool.release(b);
+  }
+  assert(pool.distinct() == 0);
+
+  // bulk random numbers have the right moments, and skips the right gaps
+  Random random(1);
+  float normals[4096];
+  random.normals(normals, 4096);
+  float mean = 0.0f, variance = 0.0f;
+  for (int i = 0; i < 4096; i++) {
+    mean += normals[i] / 4096;
+    variance += normals[i] * normals[i] / 4096;
+  }
+  assert(fabs(mean) < 0.1f && fabs(variance - 1.0f) < 0.1f);
+  float gaps = 0.0f;
+  for (int i = 0; i < 4096; i++) {
+    gaps += random.skip(0.1f) / 4096.0f;
+  }
+  assert(fabs(gaps - 9.0f) < 1.0f);
+  assert(fabs(Random::log_approx(0.3f) - logf(0.3f)) < 1e-6f);
+
+  // the wheel hands agents back on their frame, across laps, once
+  Scheduler wheel;
+  std::vector<Scheduler::Entry> woken;
+  wheel.schedule(2, 5);
+  wheel.schedule(1, 5);
+  wheel.schedule(3, 5 + Scheduler::SLOTS);
+  wheel.schedule(4, 5);
+  wheel.cancel(4);
+  wheel.schedule(1, 7);
+  wheel.due(5, woken);
+  assert(woken.size() == 1 && woken[0].agent == 2);
+  wheel.due(7, woken);
+  assert(woken.size() == 1 && woken[0].agent == 1 && wheel.is_current(woken[0]));
+  wheel.due(5 + Scheduler::SLOTS, woken);
+  assert(woken.size() == 1 && woken[0].agent == 3);
+  wheel.due(5 + 2 * Scheduler::SLOTS, woken);
+  assert(woken.empty());
+
+  // lineage queries agree across spilled and resident chunks
+  std::string lineage_test = "/tmp/patterns-lineage-test-" + std::to_string(getpid());
+  {
+    Lineage tree(lineage_test, 4, 2);
+    assert(tree.birth(0, 0, 0) == 1);
+    for (uint64_t id = 2; id <= 40; id++) {
+      tree.birth(id / 2, id, (int)id);
+      tree.death(id, id + 100, 100, (int)id, id % 2 ? DEATH_KILLED : DEATH_STARVATION);
+    }
+    std::vector<uint64_t> found;
+    tree.ancestors(37, found);
+    assert(found.size() == 5 && found[0] == 18 && found[4] == 1);
+    tree.descendants(5, found);
+    assert(found.size() == 7 && found[0] == 10 && found[6] == 40);
+    Birth birth = tree.birth_of(33);
+    assert(birth.parent == 16 && birth.frame == 33 && birth.mutations == 33);
+    Death death;
+    assert(tree.death_of(7, death) && death.cause == DEATH_KILLED && death.score == 7);
+    assert(!tree.death_of(1, death));
+    tree.death(1, 999, 999, 1, DEATH_STARVATION);
+    assert(tree.death_of(1, death) && death.frame == 999 && death.cause == DEATH_STARVATION);
+  }
+  unlink((lineage_test + ".births").c_str());
+  unlink((lineage_test + ".deaths").c_str());
+
+  // distance kernels agree with the plain loops, and species found and fold
+  float a_genes[Species::DIMS] = { }, b_genes[Species::DIMS] = { };
+  float l2 = 0.0f, ab = 0.0f, aa = 0.0f, bb = 0.0f;
+  for (int i = 0; i < DNA_SIZE; i++) {
+    a_genes[i] = rng.normal();
+    b_genes[i] = rng.normal();
+    l2 += (a_genes[i] - b_genes[i]) * (a_genes[i] - b_genes[i]);
+    ab += a_genes[i] * b_genes[i];
+    aa += a_genes[i] * a_genes[i];
+    bb += b_genes[i] * b_genes[i];
+  }
+  assert(fabs(l2_squared<Species::DIMS>(a_genes, b_genes) - l2) < l2 * 1e-5f);
+  assert(fabs(cosine_distance<Species::DIMS>(a_genes, b_genes, sqrtf(aa), sqrtf(bb)) - (1.0f - ab / sqrtf(aa * bb))) < 1e-5f);
+  Species clusters;
+  clusters.configure(Species::L2, 1.0f);
+  int first = clusters.join(a_genes, 0.5f);
+  a_genes[0] += 0.5f;
+  assert(clusters.join(a_genes, 0.0f) == first);
+  int second = clusters.join(b_genes, 0.25f);
+  assert(second != first && clusters.count() == 2 && clusters.size(first) == 2 && clusters.hue(second) == 0.25f);
+  clusters.leave(second);
+  assert(clusters.count() == 1);
+  clusters.begin_recenter();
+  clusters.accumulate(first, a_genes);
+  clusters.end_recenter();
+  a_genes[0] += 0.9f;
+  assert(clusters.join(a_genes, 0.0f) == first);
+
+  // population stats follow births, meals and deaths without a scan
+  PopulationStats population;
+  population.birth(1, 0, 10);
+  population.birth(2, 1, 20);
+  population.birth(3, 2, 30);
+  population.meal(0);
+  population.meal(1);
+  population.meal(0);
+  population.death(1, 0, 10, 0, DEATH_STARVATION);
+  StatsSnapshot counted = population.snapshot(40);
+  assert(counted.live == 2 && counted.max_age == 20 && counted.mean_age == 15.0f);
+  assert(counted.max_score == 2 && counted.mean_score == 1.5f && population.total_score() == 3);
+  population.death(2, 1, 20, 2, DEATH_KILLED);
+  counted = population.snapshot(40);
+  assert(counted.max_score == 1 && counted.max_age == 10 && counted.deaths[DEATH_KILLED] == 1);
+  // the oldest is of the agents in play, and slots are reused
+  population.birth(4, 0, 35);
+  assert(population.snapshot(40).max_age == 10);
+  // parked agents leave every figure, and come back born later
+  population.park(2, 1);
+  counted = population.snapshot(40);
+  assert(counted.live == 1 && counted.max_age == 5 && counted.max_score == 0 && population.total_score() == 0);
+  population.unpark(2, 38, 1);
+  counted = population.snapshot(40);
+  assert(counted.live == 2 && counted.max_age == 5 && counted.mean_age == 3.5f && population.total_score() == 1);
+  population.park(2, 1);
+  population.death(3, 2, 38, 1, DEATH_KILLED);
+  counted = population.snapshot(40);
+  assert(counted.live == 1 && counted.deaths[DEATH_KILLED] == 2 && population.total_score() == 0);
+
+  // mailboxes hand migrants over in order and turn them away when full
+  static Mailbox mailbox;
+  Migrant migrant;
+  for (int m = 0; m < Mailbox::SLOTS; m++) {
+    migrant.hue = m;
+    assert(mailbox.send(migrant));
+  }
+  assert(!mailbox.send(migrant));
+  assert(mailbox.receive(migrant) && migrant.hue == 0.0f);
+  assert(mailbox.send(migrant));
+  for (int m = 1; m < Mailbox::SLOTS; m++) {
+    assert(mailbox.receive(migrant) && migrant.hue == m);
+  }
+  assert(mailbox.receive(migrant) && migrant.hue == 0.0f && !mailbox.receive(migrant));
+
+  // the timeline replays deltas onto the last keyframe before a frame, and
+  // forgets keyframes once their deltas have been overwritten
+  Timeline history;
+  history.allocate(2, 10, 4);
+  WorldView scene;
+  AgentView empty = { };
+  empty.out = true;
+  scene.frame = 0;
+  scene.agents.assign(2, empty);
+  scene.food.assign(3, 0);
+  history.keyframe(scene);
+  history.birth(3, 1, 5, 6, 2, 0.5f, 100.0f);
+  history.food(4, 2, 1);
+  assert(history.seek(10, scene));
+  history.keyframe(scene);
+  history.turn(12, 1, 7, 6, 3, 90.0f);
+  assert(history.seek(3, scene) && !scene.agents[1].out && scene.agents[1].q == 5 && scene.food[2] == 0);
+  assert(history.seek(12, scene) && scene.agents[1].q == 7 && scene.agents[1].born == 3);
+  assert(scene.agents[1].touched == 12 && fabsf(scene.agents[1].hue - 0.5f) < 1e-4f && scene.food[2] == 1);
+  history.death(15, 1);
+  assert(history.seek(15, scene) && scene.agents[1].out);
+  assert(history.earliest() == 0);
+  history.food(16, 0, 1);
+  assert(history.earliest() == 10 && !history.seek(9, scene));
+
+  // sensor offsets step the way the sim's directions do
+  Senses standard = Senses::standard();
+  for (int s = 0; s < SENSOR_COUNT; s++) {
+    for (int facing = 0; facing < 6; facing++) {
+      int distance[SENSOR_COUNT] = { 0, 1, 2, 3, 1, 2, 1, 2, 0 };
+      int turn[SENSOR_COUNT] = { 0, 0, 0, 0, 1, 1, -1, -1, 0 };
+      int q = 0, r = 0;
+      for (int step = 0; step < distance[s]; step++) {
+        axial_add_direction(q, r, direction_add(facing, turn[s]));
+      }
+      assert(standard.sensors[s].dq[facing] == q && standard.sensors[s].dr[facing] == r);
+    }
+  }
+  // banks tell genomes wired one way from another and give back the whole
+  // layout, and take those from before it was recorded as standard
+  Senses rewired = standard;
+  rewired.behaviors[0] = BEHAVE_MOVE;
+  rewired.behaviors[1] = BEHAVE_EAT;
+  BankHeader bank_header = { BankHeader::MAGIC, DNA_SIZE, sizeof(BankRecord), rewired.signature(), rewired };
+  Senses banked;
+  assert(bank_header.holds(rewired.signature()) && !bank_header.holds(standard.signature()));
+  assert(bank_header.layout(banked) && banked.signature() == rewired.signature() && bank_header.size() == sizeof(BankHeader));
+  bank_header.magic = BankHeader::SIGNED_MAGIC;
+  assert(!bank_header.layout(banked) && bank_header.size() == offsetof(BankHeader, senses));
+  bank_header.signature = 0;
+  assert(bank_header.holds(standard.signature()) && bank_header.layout(banked) && banked.signature() == standard.signature());
+
+  // the viewport keeps the hexes around the camera and leaves out the rest
+  int camera_hex_x, camera_hex_y;
+  axial_to_xy(10, 10, camera_hex_x, camera_hex_y);
+  Viewport close(camera_hex_x, camera_hex_y, 1.0f);
+  assert(close.contains(10, 10) && close.contains(12, 9) && !close.contains(0, 10) && !close.contains(10, 0));
+  Viewport far(camera_hex_x, camera_hex_y, 0.1f);
+  assert(far.contains(0, 0) && far.contains(Q - 1, R - 1) && far.contains(Q - 1, 0));
+
+  // a trace keeps the latest decisions of the agents selected, and a full
+  // tracer gives up the ring taken longest ago
+  static Tracer traces;
+  assert(!traces.active() && traces.ring_of(0) < 0);
+  for (int t = 1; t < Tracer::RINGS; t++) {
+    traces.select(100 + t, t, 10 + t);
+  }
+  traces.select(7, 70, 5);
+  for (int f = 0; f < Tracer::DEPTH + 5; f++) {
+    traces.record(traces.ring_of(7)).frame = f;
+  }
+  int ring7 = traces.ring_of(7);
+  assert(traces.active() && traces.size(ring7) == Tracer::DEPTH);
+  assert(traces.back(ring7, 0).frame == Tracer::DEPTH + 4 && traces.back(ring7, Tracer::DEPTH - 1).frame == 5);
+  traces.select(200, 200, 30);
+  assert(traces.ring_of(7) < 0 && traces.ring_of(200) == ring7 && traces.size(ring7) == 0);
+  traces.select(201, 201, 31);
+  assert(traces.ring_of(101) < 0 && traces.ring_of(201) >= 0);
+  // a dead agent's ring is free again but kept for a dump until taken
+  traces.record(traces.ring_of(102)).frame = 40;
+  traces.end(102);
+  assert(traces.ring_of(102) < 0 && traces.kept() == Tracer::RINGS);
+  traces.select(202, 202, 41);
+  assert(traces.ring_of(103) >= 0 && traces.ring_of(202) >= 0 && traces.kept() == Tracer::RINGS);
+  for (int t = 3; t < Tracer::RINGS; t++) {
+    traces.deselect(100 + t);
+  }
+  traces.deselect(200);
+  traces.deselect(201);
+  traces.deselect(202);
+  assert(!traces.active() && traces.kept() == 0);
+}
@@ -1,4 +1,5 @@
 #include <vector>
+#include <string>
 #include <cmath>
 #include <random>
 #include <cassert>
@@ -17,6 +18,22 @@ using std::max;
 #include <cfloat>
 
 #include "Node.h"
+#include "Brain.h"
+#include "GenomePool.h"
+#include "AgentPool.h"
+#include "Random.h"
+#include "Scheduler.h"
+#include "Lineage.h"
+#include "Species.h"
+#include "Stats.h"
+#include "Monitor.h"
+#include "Islands.h"
+#include "Timeline.h"
+#include "Journal.h"
+#include "GenomeBank.h"
+#include "Senses.h"
+#include "Trace.h"
+#include <unistd.h>
 #include <libconfig.h++>
 using namespace libconfig;
 